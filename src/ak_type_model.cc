@@ -0,0 +1,230 @@
+#include "ak_type_model.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace {
+
+struct ModelClass {
+    std::string_view name;
+    // Template parameters, separated by spaces.
+    std::string_view parameters;
+};
+// The AK types the rules ask about, and the ones that lead to them in a chain
+// of calls.
+constexpr std::array<ModelClass, 19> model_classes { {
+    { "Vector", "T" },
+    { "Span", "T" },
+    { "Optional", "T" },
+    { "ErrorOr", "T" },
+    { "RefPtr", "T" },
+    { "NonnullRefPtr", "T" },
+    { "OwnPtr", "T" },
+    { "NonnullOwnPtr", "T" },
+    { "HashMap", "K V" },
+    { "HashTable", "T" },
+    { "StringBuilder", "" },
+    { "String", "" },
+    { "ByteString", "" },
+    { "StringView", "" },
+    { "FlyString", "" },
+    { "DeprecatedFlyString", "" },
+    { "LexicalPath", "" },
+    { "JsonValue", "" },
+    { "JsonObject", "" },
+} };
+
+struct ModelMember {
+    std::string_view class_name;
+    std::string_view member;
+    std::string_view type;
+};
+constexpr std::array<ModelMember, 109> model_members { {
+    { "Vector", "operator[]", "T&" },
+    { "Vector", "first", "T&" },
+    { "Vector", "last", "T&" },
+    { "Vector", "at", "T&" },
+    { "Vector", "take_first", "T" },
+    { "Vector", "take_last", "T" },
+    { "Vector", "size", "size_t" },
+    { "Vector", "is_empty", "bool" },
+    { "Vector", "data", "T*" },
+    { "Vector", "span", "Span<T>" },
+    { "Vector", "contains_slow", "bool" },
+    { "Vector", "find_first_index", "Optional<size_t>" },
+    { "Vector", "first_matching", "Optional<T>" },
+    { "Vector", "last_matching", "Optional<T>" },
+    { "Vector", "append", "void" },
+    { "Vector", "extend", "void" },
+    { "Vector", "clear", "void" },
+    { "Span", "operator[]", "T&" },
+    { "Span", "first", "T&" },
+    { "Span", "last", "T&" },
+    { "Span", "at", "T&" },
+    { "Span", "size", "size_t" },
+    { "Span", "is_empty", "bool" },
+    { "Span", "data", "T*" },
+    { "Span", "slice", "Span<T>" },
+    { "Span", "trim", "Span<T>" },
+    { "Optional", "value", "T&" },
+    { "Optional", "release_value", "T" },
+    { "Optional", "value_or", "T" },
+    { "Optional", "has_value", "bool" },
+    { "Optional", "operator->", "T*" },
+    { "ErrorOr", "value", "T&" },
+    { "ErrorOr", "release_value", "T" },
+    { "ErrorOr", "is_error", "bool" },
+    { "ErrorOr", "error", "Error" },
+    { "RefPtr", "ptr", "T*" },
+    { "RefPtr", "is_null", "bool" },
+    { "RefPtr", "release_nonnull", "NonnullRefPtr<T>" },
+    { "RefPtr", "operator->", "T*" },
+    { "NonnullRefPtr", "ptr", "T*" },
+    { "NonnullRefPtr", "operator->", "T*" },
+    { "OwnPtr", "ptr", "T*" },
+    { "OwnPtr", "is_null", "bool" },
+    { "OwnPtr", "release_nonnull", "NonnullOwnPtr<T>" },
+    { "OwnPtr", "operator->", "T*" },
+    { "NonnullOwnPtr", "ptr", "T*" },
+    { "NonnullOwnPtr", "operator->", "T*" },
+    { "HashMap", "get", "Optional<V>" },
+    { "HashMap", "find", "HashMapIterator" },
+    { "HashMap", "contains", "bool" },
+    { "HashMap", "keys", "Vector<K>" },
+    { "HashMap", "values", "Vector<V>" },
+    { "HashMap", "size", "size_t" },
+    { "HashMap", "is_empty", "bool" },
+    { "HashMap", "set", "HashSetResult" },
+    { "HashMap", "remove", "bool" },
+    { "HashTable", "contains", "bool" },
+    { "HashTable", "size", "size_t" },
+    { "HashTable", "is_empty", "bool" },
+    { "HashTable", "set", "HashSetResult" },
+    { "HashTable", "remove", "bool" },
+    { "StringBuilder", "append", "void" },
+    { "StringBuilder", "appendff", "void" },
+    { "StringBuilder", "to_byte_string", "ByteString" },
+    { "StringBuilder", "to_string", "ErrorOr<String>" },
+    { "StringBuilder", "to_fly_string", "ErrorOr<FlyString>" },
+    { "StringBuilder", "string_view", "StringView" },
+    { "StringBuilder", "length", "size_t" },
+    { "StringBuilder", "is_empty", "bool" },
+    { "StringBuilder", "clear", "void" },
+    { "String", "bytes_as_string_view", "StringView" },
+    { "String", "to_byte_string", "ByteString" },
+    { "String", "is_empty", "bool" },
+    { "String", "to_lowercase", "ErrorOr<String>" },
+    { "String", "to_uppercase", "ErrorOr<String>" },
+    { "String", "split", "ErrorOr<Vector<String>>" },
+    { "String", "substring_from_byte_offset", "ErrorOr<String>" },
+    { "ByteString", "view", "StringView" },
+    { "ByteString", "length", "size_t" },
+    { "ByteString", "is_empty", "bool" },
+    { "ByteString", "characters", "char const*" },
+    { "ByteString", "to_lowercase", "ByteString" },
+    { "ByteString", "to_uppercase", "ByteString" },
+    { "ByteString", "substring", "ByteString" },
+    { "ByteString", "substring_view", "StringView" },
+    { "ByteString", "split", "Vector<ByteString>" },
+    { "ByteString", "split_view", "Vector<StringView>" },
+    { "ByteString", "trim_whitespace", "ByteString" },
+    { "StringView", "length", "size_t" },
+    { "StringView", "is_empty", "bool" },
+    { "StringView", "to_byte_string", "ByteString" },
+    { "StringView", "substring_view", "StringView" },
+    { "StringView", "split_view", "Vector<StringView>" },
+    { "StringView", "trim_whitespace", "StringView" },
+    { "StringView", "starts_with", "bool" },
+    { "StringView", "ends_with", "bool" },
+    { "StringView", "characters_without_null_termination", "char const*" },
+    { "FlyString", "to_string", "String" },
+    { "FlyString", "bytes_as_string_view", "StringView" },
+    { "FlyString", "is_empty", "bool" },
+    { "DeprecatedFlyString", "view", "StringView" },
+    { "DeprecatedFlyString", "to_byte_string", "ByteString" },
+    { "DeprecatedFlyString", "length", "size_t" },
+    { "DeprecatedFlyString", "is_empty", "bool" },
+    { "LexicalPath", "string", "ByteString" },
+    { "LexicalPath", "basename", "StringView" },
+    { "LexicalPath", "parts", "Vector<ByteString>" },
+    { "JsonValue", "as_object", "JsonObject&" },
+    { "JsonObject", "get_byte_string", "Optional<ByteString>" },
+} };
+static_assert(std::ranges::all_of(model_members, [](auto const& member) {
+    return std::ranges::find(model_classes, member.class_name, &ModelClass::name) != model_classes.end();
+}));
+
+std::string member_key(std::string_view class_name, std::string_view member)
+{
+    std::string key { class_name };
+    key += "::";
+    key += member;
+    return key;
+}
+
+bool is_name_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// `type` with every whole identifier that is a parameter replaced by its argument.
+std::string substitute(std::string_view type, std::string_view parameters, std::vector<std::string> const& arguments)
+{
+    std::vector<std::string_view> names;
+    for (size_t start = 0; start < parameters.size();) {
+        auto end = std::min(parameters.find(' ', start), parameters.size());
+        names.push_back(parameters.substr(start, end - start));
+        start = end + 1;
+    }
+
+    std::string result;
+    for (size_t position = 0; position < type.size();) {
+        if (!is_name_char(type[position])) {
+            result += type[position++];
+            continue;
+        }
+        auto end = position;
+        while (end < type.size() && is_name_char(type[end]))
+            ++end;
+        auto word = type.substr(position, end - position);
+        auto parameter = std::ranges::find(names, word);
+        auto index = static_cast<size_t>(parameter - names.begin());
+        if (parameter != names.end() && index < arguments.size())
+            result += arguments[index];
+        else
+            result += word;
+        position = end;
+    }
+    return result;
+}
+
+}
+
+AkTypeModel const& AkTypeModel::instance()
+{
+    static AkTypeModel const model;
+    return model;
+}
+
+AkTypeModel::AkTypeModel()
+{
+    std::vector<std::string> class_names;
+    for (auto const& model_class : model_classes)
+        class_names.emplace_back(model_class.name);
+    m_classes = PerfectHash(std::move(class_names));
+    std::vector<std::string> member_keys;
+    for (auto const& member : model_members)
+        member_keys.push_back(member_key(member.class_name, member.member));
+    m_members = PerfectHash(std::move(member_keys));
+}
+
+std::optional<std::string> AkTypeModel::member_type(ParsedType const& type, std::string_view member) const
+{
+    auto model_class = m_classes.find(type.name);
+    if (!model_class)
+        return std::nullopt;
+    auto index = m_members.find(member_key(type.name, member));
+    if (!index)
+        return std::nullopt;
+    return substitute(model_members[*index].type, model_classes[*model_class].parameters, type.arguments);
+}
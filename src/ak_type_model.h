@@ -0,0 +1,31 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include "perfect_hash.h"
+#include "symbol_database.h"
+
+// The AK types and their members with the types they return, built in so that
+// the semantic rules know e.g. that Vector<T>::first() returns a T& or that
+// StringBuilder::string_view() returns a StringView without the AK headers
+// being parsed. Member types are written in terms of the class's template
+// parameters, which member_type() replaces with the arguments of the type it
+// is asked about. `operator->` stands for what -> on the type reaches.
+class AkTypeModel {
+public:
+    static AkTypeModel const& instance();
+
+    // The type of `member` of `type`, if `type` is an AK type that has it.
+    std::optional<std::string> member_type(ParsedType const& type, std::string_view member) const;
+
+    // Whether the #include name (e.g. "AK/Vector.h") is one of the headers the
+    // model stands in for.
+    static bool covers_include(std::string_view name) { return name.starts_with("AK/"); }
+
+private:
+    AkTypeModel();
+
+    // Both in the order of the tables in the .cc file.
+    PerfectHash m_classes;
+    PerfectHash m_members;
+};
@@ -0,0 +1,75 @@
+#include "allocation_counters.h"
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include <sys/resource.h>
+
+// Trivially constructible, so operator new can use it on a thread before
+// anything else ran there.
+static thread_local AllocationCounters counters;
+
+AllocationCounters thread_allocation_counters() {
+    return counters;
+}
+
+size_t peak_rss_bytes() {
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    // Linux reports kilobytes.
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+#ifdef AK_TO_STD_COUNT_ALLOCATIONS
+
+// The usable size is what malloc really handed out, and is known again when
+// the memory is freed through an unsized delete.
+static void* counted_allocation(void* pointer) {
+    if (pointer) {
+        counters.allocations++;
+        counters.bytes += malloc_usable_size(pointer);
+    }
+    return pointer;
+}
+
+static void counted_free(void* pointer) {
+    if (!pointer)
+        return;
+    counters.freed_bytes += malloc_usable_size(pointer);
+    free(pointer);
+}
+
+static void* allocate(size_t size) {
+    if (auto* pointer = counted_allocation(malloc(size ? size : 1)))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+static void* allocate_aligned(size_t size, std::align_val_t alignment) {
+    // aligned_alloc wants a multiple of the alignment.
+    auto align = static_cast<size_t>(alignment);
+    auto rounded_size = size ? (size + align - 1) / align * align : align;
+    if (auto* pointer = counted_allocation(aligned_alloc(align, rounded_size)))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, std::nothrow_t const&) noexcept { return counted_allocation(malloc(size ? size : 1)); }
+void* operator new[](size_t size, std::nothrow_t const&) noexcept { return counted_allocation(malloc(size ? size : 1)); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocate_aligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocate_aligned(size, alignment); }
+
+void operator delete(void* pointer) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, std::nothrow_t const&) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, std::nothrow_t const&) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { counted_free(pointer); }
+
+#endif
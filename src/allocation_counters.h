@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+struct AllocationCounters {
+    uint64_t allocations { 0 };
+    uint64_t bytes { 0 };
+    uint64_t freed_bytes { 0 };
+
+    // Bytes allocated and not freed again, can be negative for a span of time
+    // that frees more than it allocates.
+    int64_t live_bytes() const { return static_cast<int64_t>(bytes - freed_bytes); }
+
+    AllocationCounters& operator+=(AllocationCounters const& other)
+    {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        freed_bytes += other.freed_bytes;
+        return *this;
+    }
+
+    AllocationCounters operator-(AllocationCounters const& other) const
+    {
+        return { allocations - other.allocations, bytes - other.bytes, freed_bytes - other.freed_bytes };
+    }
+};
+
+// Whether the global operator new and delete count allocations, which is a
+// build option (AK_TO_STD_COUNT_ALLOCATIONS) as it slows every allocation down.
+#ifdef AK_TO_STD_COUNT_ALLOCATIONS
+inline constexpr bool allocation_counting_enabled = true;
+#else
+inline constexpr bool allocation_counting_enabled = false;
+#endif
+
+// What the calling thread allocated and freed since it started, zero without
+// allocation counting. Memory freed by another thread than the one that
+// allocated it is charged to the freeing thread.
+AllocationCounters thread_allocation_counters();
+
+// The highest resident set size of the process so far.
+size_t peak_rss_bytes();
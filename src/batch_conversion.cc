@@ -0,0 +1,260 @@
+#include "batch_conversion.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include "compile_commands.h"
+#include "convert_ak_to_std.h"
+#include "file_io.h"
+#include "trace.h"
+
+namespace {
+
+struct IncludeDirective {
+    std::string name;
+    bool is_quoted { false };
+};
+
+std::optional<IncludeDirective> parse_include_directive(std::string_view line)
+{
+    auto skip_whitespace = [&] {
+        while (!line.empty() && std::isspace(static_cast<unsigned char>(line.front())))
+            line.remove_prefix(1);
+    };
+
+    skip_whitespace();
+    if (!line.starts_with('#'))
+        return std::nullopt;
+    line.remove_prefix(1);
+    skip_whitespace();
+    if (!line.starts_with("include"))
+        return std::nullopt;
+    line.remove_prefix(strlen("include"));
+    skip_whitespace();
+    if (line.empty() || (line.front() != '"' && line.front() != '<'))
+        return std::nullopt;
+
+    char terminator = line.front() == '"' ? '"' : '>';
+    auto end_pos = line.find(terminator, 1);
+    if (end_pos == std::string_view::npos)
+        return std::nullopt;
+    return IncludeDirective { std::string { line.substr(1, end_pos - 1) }, terminator == '"' };
+}
+
+std::optional<std::string> resolve_include(IncludeDirective const& include, std::filesystem::path const& including_file, std::vector<std::string> const& include_directories)
+{
+    if (include.is_quoted) {
+        auto candidate = (including_file.parent_path() / include.name).lexically_normal();
+        if (std::filesystem::is_regular_file(candidate))
+            return candidate.string();
+    }
+    for (auto const& directory : include_directories) {
+        auto candidate = (std::filesystem::path { directory } / include.name).lexically_normal();
+        if (std::filesystem::is_regular_file(candidate))
+            return candidate.string();
+    }
+    return std::nullopt;
+}
+
+bool is_below(std::filesystem::path const& path, std::filesystem::path const& root)
+{
+    auto relative = path.lexically_relative(root);
+    return !relative.empty() && *relative.begin() != "..";
+}
+
+// AK headers outside the source root are context only, and what the rules
+// need from them comes from the AkTypeModel. They are neither loaded nor
+// handed to the engine.
+bool is_modelled_header(std::filesystem::path const& path, std::filesystem::path const& source_root)
+{
+    return path.parent_path().filename() == "AK" && !is_below(path, source_root);
+}
+
+// Loads a translation unit and everything it can reach through #include.
+// Includes that don't resolve against its include directories (system
+// headers) and modelled AK headers are not followed.
+std::vector<std::pair<std::string, std::string>> load_reachable_files(std::string const& translation_unit, std::vector<std::string> const& include_directories, std::filesystem::path const& source_root)
+{
+    std::vector<std::pair<std::string, std::string>> files;
+    std::set<std::string> seen { translation_unit };
+    std::vector<std::string> pending { translation_unit };
+    while (!pending.empty()) {
+        auto path = std::move(pending.back());
+        pending.pop_back();
+
+        auto content = read_file(path);
+        std::string_view remaining = content;
+        while (!remaining.empty()) {
+            auto end_pos = remaining.find('\n');
+            auto line = remaining.substr(0, end_pos);
+            remaining.remove_prefix(end_pos == std::string_view::npos ? remaining.size() : end_pos + 1);
+
+            auto include = parse_include_directive(line);
+            if (!include)
+                continue;
+            auto resolved = resolve_include(*include, path, include_directories);
+            if (!resolved || (AkTypeModel::covers_include(include->name) && is_modelled_header(*resolved, source_root)))
+                continue;
+            if (seen.insert(*resolved).second)
+                pending.push_back(std::move(*resolved));
+        }
+        files.emplace_back(std::move(path), std::move(content));
+    }
+    return files;
+}
+
+}
+
+int convert_compile_commands(BatchOptions const& options)
+{
+    auto commands = parse_compile_commands(read_file(options.compile_commands_path));
+
+    // A file can be listed several times (e.g. once per build configuration), the first entry wins.
+    std::vector<CompileCommand const*> translation_units;
+    std::set<std::string> seen_files;
+    for (auto const& command : commands) {
+        if (seen_files.insert(command.absolute_file()).second)
+            translation_units.push_back(&command);
+    }
+
+    auto source_root = std::filesystem::absolute(options.source_root).lexically_normal();
+    auto output_path_for = [&](std::string const& file) -> std::optional<std::filesystem::path> {
+        if (!is_below(file, source_root))
+            return std::nullopt;
+        return std::filesystem::path { options.output_dir } / std::filesystem::path { file }.lexically_relative(source_root);
+    };
+
+    // Headers are reachable from many translation units but only converted once.
+    std::mutex claimed_files_mutex;
+    std::set<std::string> claimed_files;
+
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<size_t>(jobs, std::max<size_t>(1, translation_units.size()));
+
+    // The include lines that translation units have in common are converted once for all workers.
+    IncludeRewriter include_rewriter(options.rules ? *options.rules : RuleSet::built_in(), options.include_path_for_output);
+    // So are the lines that repeat across the sources, like common includes and idioms.
+    LineCache line_cache(options.line_cache_bytes);
+
+    std::atomic<size_t> next_translation_unit { 0 };
+    std::atomic<size_t> failures { 0 };
+    std::mutex stats_mutex;
+    auto worker = [&](unsigned worker_index) {
+        set_trace_thread_name(fmt::format("worker {}", worker_index));
+        // Each worker keeps one converter for all of its translation units, so
+        // headers that several of them include are only parsed once per worker.
+        // Its context grows with every translation unit, what bounds it is the
+        // memory budget: files the current unit can't reach are evicted first.
+        ConvertAkToStd convert_object;
+        convert_object.add_include_filepath_for_output(options.include_path_for_output);
+        convert_object.set_file_loader([&](std::string const& path) -> std::optional<std::string> {
+            if (is_modelled_header(std::filesystem::absolute(path).lexically_normal(), source_root))
+                return std::nullopt;
+            try {
+                return read_file(path);
+            } catch (std::exception const&) {
+                return std::nullopt;
+            }
+        });
+        convert_object.set_memory_budget(options.max_memory / jobs);
+        ConversionStats stats;
+        if (options.stats)
+            convert_object.set_stats(&stats);
+        if (options.stats && options.stats->has_hardware_counters())
+            stats.enable_hardware_counters();
+        convert_object.set_query_recorder(options.query_recorder);
+        convert_object.set_rules(options.rules);
+        convert_object.set_symbol_database(options.symbol_database);
+        convert_object.set_include_rewriter(&include_rewriter);
+        if (options.line_cache_bytes)
+            convert_object.set_line_cache(&line_cache);
+
+        while (true) {
+            auto index = next_translation_unit++;
+            if (index >= translation_units.size())
+                break;
+
+            auto const& command = *translation_units[index];
+            auto translation_unit = command.absolute_file();
+            TRACE_SPAN("file", "translation unit", translation_unit);
+            try {
+                std::vector<std::pair<std::string, std::string>> reachable_files;
+                {
+                    ConversionStats::Scope scope(options.stats ? &stats : nullptr, Phase::Load);
+                    TRACE_SPAN("load", "load_reachable_files", translation_unit);
+                    reachable_files = load_reachable_files(translation_unit, command.include_directories(), source_root);
+                }
+
+                std::vector<std::string> files_to_convert;
+                {
+                    std::lock_guard lock(claimed_files_mutex);
+                    for (auto const& [path, content] : reachable_files) {
+                        if (output_path_for(path) && claimed_files.insert(path).second)
+                            files_to_convert.push_back(path);
+                    }
+                }
+                if (files_to_convert.empty())
+                    continue;
+
+                // Reachable files that convert to themselves. They are copied instead of
+                // converted and not added to the converter: a declaration lookup of
+                // another file that leads into one, e.g. to the class of a member in
+                // `m_node->parent()->children().first()`, reads it through the file
+                // loader, which keeps nothing in memory.
+                std::set<std::string> unchanged_files;
+                std::vector<std::string> reachable_paths;
+                for (auto const& [path, content] : reachable_files) {
+                    if (!convert_object.has_file(path)) {
+                        if (convert_object.needs_conversion(content))
+                            convert_object.add_file(path, content);
+                        else
+                            unchanged_files.insert(path);
+                    }
+                    reachable_paths.push_back(path);
+                }
+                // Everything the previous translation unit used but this one can't reach becomes evictable.
+                convert_object.set_pinned_files(reachable_paths);
+
+                for (auto const& path : files_to_convert) {
+                    if (unchanged_files.contains(path)) {
+                        ConversionStats::Scope scope(options.stats ? &stats : nullptr, Phase::Output);
+                        TRACE_SPAN("write", "copy_output_file", path);
+                        copy_output_file(path, *output_path_for(path));
+                        if (options.stats)
+                            stats.copied_files++;
+                        outln("copied: {}", path);
+                        continue;
+                    }
+                    auto converted = convert_object.convert(path.c_str());
+                    ConversionStats::Scope scope(options.stats ? &stats : nullptr, Phase::Output);
+                    TRACE_SPAN("write", "write_output_file", path);
+                    write_output_file(*output_path_for(path), converted);
+                    outln("converted: {}", path);
+                }
+            } catch (std::exception const& e) {
+                outln("{}: {}", translation_unit, e.what());
+                failures++;
+            }
+        }
+
+        if (options.stats) {
+            std::lock_guard lock(stats_mutex);
+            options.stats->merge(stats);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < jobs; ++i)
+        workers.emplace_back(worker, i);
+    for (auto& thread : workers)
+        thread.join();
+
+    outln("{} translation units, {} failed", translation_units.size(), failures.load());
+    return failures ? 1 : 0;
+}
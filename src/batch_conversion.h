@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+class ConversionStats;
+class EngineQueryRecorder;
+class RuleSet;
+class SymbolDatabase;
+
+struct BatchOptions {
+    std::string compile_commands_path;
+    std::string output_dir;
+    // Only files below this directory are converted, everything else is context.
+    std::string source_root;
+    std::string include_path_for_output;
+    // 0 uses one worker per hardware thread.
+    unsigned jobs { 0 };
+    // Upper bound for the per-file state all workers keep around, split evenly
+    // between them. A worker keeps the files of every translation unit it
+    // converted, so this is the only bound on its context. 0 means no limit:
+    // each worker may end up holding every file it reached.
+    size_t max_memory { 0 };
+    // Upper bound for the lines converted once and shared by all workers, see
+    // LineCache. 0 disables the cache.
+    size_t line_cache_bytes { 64 << 20 };
+    // If set, receives the merged statistics of all workers.
+    ConversionStats* stats { nullptr };
+    // If set, every worker records its engine queries into it as a stream of its own.
+    EngineQueryRecorder* query_recorder { nullptr };
+    // The rules all workers convert with, the built-in rules if null.
+    RuleSet const* rules { nullptr };
+    // If set, receiver types are looked up in it before the engine is asked.
+    SymbolDatabase const* symbol_database { nullptr };
+};
+
+// Converts every translation unit of a compilation database, and every header
+// below the source root they include, on a pool of worker threads. Each
+// translation unit only loads the files it can reach through its includes.
+// Returns the process exit code.
+int convert_compile_commands(BatchOptions const& options);
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "convert_ak_to_std.h"
+#include "corpus_generator.h"
+#include "file_io.h"
+#include "lexer.h"
+
+// Micro and end-to-end benchmarks. Every benchmark runs its operation in
+// samples that are long enough for the clock to be accurate, and reports the
+// median and 95th percentile time per operation of those samples.
+//
+//   ak-to-std-bench [--filter <text>] [--samples <n>] [--max-lines <n>]
+//                   [--data-dir <dir>] [--json <file>] [--replay <queries>]
+//
+// --replay runs a log written by ak-to-std --record-queries against the
+// engine alone, which measures the engine without the rewriting around it.
+//
+// The generated corpora go from 1k lines up to --max-lines in steps of ten,
+// pass --max-lines 1000000 to include the 1M line corpus.
+
+#ifndef AK_TO_STD_TEST_DIR
+#    define AK_TO_STD_TEST_DIR "test"
+#endif
+
+// Exposes the token helpers that are protected in ConvertAkToStd.
+class BenchConverter : public ConvertAkToStd {
+public:
+    using ConvertAkToStd::file_id;
+    using ConvertAkToStd::get_token_string;
+    using ConvertAkToStd::position_of_last_matching_paren;
+    using ConvertAkToStd::text_between_matching_parens;
+    using ConvertAkToStd::token_is_left_paren;
+    using ConvertAkToStd::tokens_for;
+};
+
+struct BenchOptions {
+    std::string filter;
+    size_t samples { 15 };
+    size_t max_lines { 100000 };
+    std::string data_dir { AK_TO_STD_TEST_DIR };
+    std::string json_path;
+    std::string replay_path;
+};
+
+struct Measurement {
+    std::string name;
+    size_t iterations_per_sample { 0 };
+    size_t samples { 0 };
+    double median_ns { 0 };
+    double p95_ns { 0 };
+    // Input processed by one operation, 0 for micro-benchmarks.
+    size_t lines { 0 };
+    size_t bytes { 0 };
+};
+
+template<typename T>
+static void do_not_optimize(T const& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+class Bench {
+public:
+    explicit Bench(BenchOptions options)
+        : m_options(std::move(options))
+    {
+    }
+
+    bool wants(std::string const& name) const { return name.find(m_options.filter) != std::string::npos; }
+    BenchOptions const& options() const { return m_options; }
+    std::vector<Measurement> const& measurements() const { return m_measurements; }
+
+    void run(std::string name, std::function<void()> const& operation, size_t lines = 0, size_t bytes = 0) {
+        if (!wants(name))
+            return;
+
+        // Short operations are repeated until a sample takes at least this long.
+        static constexpr double min_sample_ns = 20e6;
+        // Slow operations get fewer samples, but never less than three.
+        static constexpr double max_total_ns = 20e9;
+
+        // Calibration doubles as warm-up.
+        size_t iterations = 1;
+        double time_ns = 0;
+        while (true) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+                operation();
+            time_ns = elapsed_ns(start);
+            if (time_ns >= min_sample_ns)
+                break;
+            iterations *= 2;
+        }
+
+        auto samples = std::clamp<size_t>(static_cast<size_t>(max_total_ns / time_ns), 3, std::max<size_t>(3, m_options.samples));
+        std::vector<double> per_operation_ns;
+        for (size_t sample = 0; sample < samples; ++sample) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+                operation();
+            per_operation_ns.push_back(elapsed_ns(start) / iterations);
+        }
+        std::sort(per_operation_ns.begin(), per_operation_ns.end());
+
+        Measurement measurement;
+        measurement.name = std::move(name);
+        measurement.iterations_per_sample = iterations;
+        measurement.samples = samples;
+        measurement.median_ns = per_operation_ns[samples / 2];
+        measurement.p95_ns = per_operation_ns[static_cast<size_t>(std::ceil(samples * 0.95)) - 1];
+        measurement.lines = lines;
+        measurement.bytes = bytes;
+        print(measurement);
+        m_measurements.push_back(std::move(measurement));
+    }
+
+private:
+    static std::string format_time(double ns) {
+        if (ns < 1e3)
+            return fmt::format("{:.1f} ns", ns);
+        if (ns < 1e6)
+            return fmt::format("{:.2f} us", ns / 1e3);
+        if (ns < 1e9)
+            return fmt::format("{:.2f} ms", ns / 1e6);
+        return fmt::format("{:.3f} s", ns / 1e9);
+    }
+
+    static void print(Measurement const& measurement) {
+        std::string throughput;
+        if (measurement.lines) {
+            auto seconds = measurement.median_ns / 1e9;
+            throughput = fmt::format("{:>14.0f} lines/s {:>10.2f} MB/s", measurement.lines / seconds, measurement.bytes / seconds / 1e6);
+        }
+        outln("{:<44}{:>12}{:>12}{}", measurement.name, format_time(measurement.median_ns), format_time(measurement.p95_ns), throughput);
+    }
+
+    BenchOptions m_options;
+    std::vector<Measurement> m_measurements;
+};
+
+static size_t count_lines(std::string const& content) {
+    return std::count(content.begin(), content.end(), '\n');
+}
+
+static void run_micro_benchmarks(Bench& bench, std::string const& ast_h, std::string const& ast_cpp) {
+    BenchConverter converter;
+    converter.add_file("AST.h", ast_h);
+    converter.add_file("AST.cpp", ast_cpp);
+    // Creates the engine and parses the file.
+    converter.convert("AST.h");
+    auto file = *converter.file_id("AST.h");
+    auto const& tokens = converter.tokens_for(file);
+    if (tokens.empty()) {
+        outln("no tokens for AST.h, skipping the micro-benchmarks");
+        return;
+    }
+
+    // Spread over the whole file, the same tokens in every run.
+    std::vector<std::pair<int, int>> positions;
+    for (size_t i = 0; i < 1024; ++i) {
+        auto const& token = tokens[(i * 7919) % tokens.size()];
+        positions.emplace_back(token.start_line, token.start_column);
+    }
+    // Identifiers that are followed by an opening paren.
+    std::vector<std::pair<int, int>> calls;
+    for (size_t i = 1; i < tokens.size(); ++i) {
+        if (converter.token_is_left_paren(file, i, tokens))
+            calls.emplace_back(tokens[i - 1].start_line, tokens[i - 1].start_column);
+    }
+
+    auto ast_cpp_lines = split_into_lines(ast_cpp);
+    PackedTokens lexed;
+    bench.run("lex AST.cpp", [&] {
+        lexed.clear();
+        LexState state = LexState::Code;
+        for (size_t row = 0; row < ast_cpp_lines.size(); ++row)
+            lex_line(ast_cpp_lines[row], row, state, lexed);
+        do_not_optimize(lexed);
+    }, ast_cpp_lines.size(), ast_cpp.size());
+
+    // The rule prefilter, next to a plain copy of the same bytes.
+    std::vector<uint8_t> line_flags;
+    bench.run("prefilter AST.cpp", [&] {
+        RuleSet::built_in().prefilter().flag_lines(ast_cpp, line_flags);
+        do_not_optimize(line_flags);
+    }, ast_cpp_lines.size(), ast_cpp.size());
+    std::string copy;
+    bench.run("copy AST.cpp", [&] {
+        copy.assign(ast_cpp);
+        do_not_optimize(copy);
+    }, ast_cpp_lines.size(), ast_cpp.size());
+
+    size_t next = 0;
+    bench.run("find_token_index", [&] {
+        auto [line, column] = positions[next++ % positions.size()];
+        do_not_optimize(find_token_index(line, column, tokens));
+    });
+
+    bench.run("replace", [&] {
+        std::string line = "    Vector<NonnullRefPtr<Declaration const>> declarations() const { return Vector<int> {}; }";
+        do_not_optimize(replace(line, "Vector", "std::vector"));
+        do_not_optimize(line);
+    });
+
+    next = 0;
+    bench.run("get_token_string", [&] {
+        do_not_optimize(converter.get_token_string(file, tokens[next++ % tokens.size()]));
+    });
+
+    if (calls.empty())
+        return;
+    next = 0;
+    bench.run("text_between_matching_parens", [&] {
+        auto [line, column] = calls[next++ % calls.size()];
+        do_not_optimize(converter.text_between_matching_parens(file, line, column, tokens));
+    });
+    next = 0;
+    bench.run("position_of_last_matching_paren", [&] {
+        auto [line, column] = calls[next++ % calls.size()];
+        do_not_optimize(converter.position_of_last_matching_paren(file, line, column, tokens));
+    });
+}
+
+static void run_end_to_end_benchmarks(Bench& bench, std::string const& ast_h, std::string const& ast_cpp) {
+    // A fresh converter per run: loading, parsing and converting.
+    auto convert_cold = [&](std::string const& name, std::string const& content, std::vector<std::pair<std::string, std::string const*>> const& context) {
+        bench.run(fmt::format("convert {}", name), [&] {
+            ConvertAkToStd converter;
+            converter.add_include_filepath_for_output("cpp_parser/");
+            for (auto const& [context_name, context_content] : context)
+                converter.add_file(context_name, *context_content);
+            do_not_optimize(converter.convert_to_string(name.c_str()));
+        }, count_lines(content), content.size());
+    };
+
+    std::vector<std::pair<std::string, std::string const*>> ast_files { { "AST.h", &ast_h }, { "AST.cpp", &ast_cpp } };
+    convert_cold("AST.h", ast_h, ast_files);
+    convert_cold("AST.cpp", ast_cpp, ast_files);
+
+    // Converting again with everything parsed, like watch mode does.
+    {
+        ConvertAkToStd converter;
+        converter.add_include_filepath_for_output("cpp_parser/");
+        converter.add_file("AST.h", ast_h);
+        converter.add_file("AST.cpp", ast_cpp);
+        bench.run("convert AST.h (warm)", [&] {
+            do_not_optimize(converter.convert_to_string("AST.h"));
+        }, count_lines(ast_h), ast_h.size());
+    }
+
+    for (size_t lines = 1000; lines <= bench.options().max_lines; lines *= 10) {
+        auto size_name = lines >= 1000000 ? fmt::format("{}M", lines / 1000000) : fmt::format("{}k", lines / 1000);
+        auto convert_name = fmt::format("generated_{}.h", size_name);
+        auto stream_name = fmt::format("stream generated_{}.h", size_name);
+        if (!bench.wants(fmt::format("convert {}", convert_name)) && !bench.wants(stream_name))
+            continue;
+
+        auto content = CorpusGenerator(1).generate_header(convert_name, lines);
+        convert_cold(convert_name, content, { { convert_name, &content } });
+
+        bench.run(stream_name, [&] {
+            std::istringstream input(content);
+            std::ostringstream output;
+            ConvertAkToStd converter;
+            converter.add_include_filepath_for_output("cpp_parser/");
+            converter.convert_stream(input, output);
+            do_not_optimize(output);
+        }, count_lines(content), content.size());
+    }
+}
+
+static void run_replay_benchmark(Bench& bench, std::string const& path) {
+    auto queries = read_engine_queries(path);
+    auto result = replay_engine_queries(queries);
+    outln("{}: {} find_declaration_of queries, {} results differ from the recording",
+        path, result.declaration_queries, result.mismatches);
+
+    bench.run(fmt::format("replay {}", std::filesystem::path { path }.filename().string()), [&] {
+        do_not_optimize(replay_engine_queries(queries));
+    });
+}
+
+static void write_json(std::string const& path, std::vector<Measurement> const& measurements) {
+    std::ofstream file(path);
+    file << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < measurements.size(); ++i) {
+        auto const& measurement = measurements[i];
+        file << fmt::format("{}\n    {{ \"name\": {}, \"samples\": {}, \"iterations_per_sample\": {}, \"median_ns\": {:.1f}, \"p95_ns\": {:.1f}",
+            i ? "," : "", json_string(measurement.name), measurement.samples, measurement.iterations_per_sample, measurement.median_ns, measurement.p95_ns);
+        if (measurement.lines) {
+            auto seconds = measurement.median_ns / 1e9;
+            file << fmt::format(", \"lines\": {}, \"bytes\": {}, \"lines_per_second\": {:.0f}, \"mb_per_second\": {:.3f}",
+                measurement.lines, measurement.bytes, measurement.lines / seconds, measurement.bytes / seconds / 1e6);
+        }
+        file << " }";
+    }
+    file << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            outln("Usage: ak-to-std-bench [--filter <text>] [--samples <n>] [--max-lines <n>] [--data-dir <dir>] [--json <file>] [--replay <queries>]");
+            return -1;
+        }
+        if (argument == "--filter")
+            options.filter = argv[++i];
+        else if (argument == "--samples")
+            options.samples = std::stoull(argv[++i]);
+        else if (argument == "--max-lines")
+            options.max_lines = std::stoull(argv[++i]);
+        else if (argument == "--data-dir")
+            options.data_dir = argv[++i];
+        else if (argument == "--json")
+            options.json_path = argv[++i];
+        else if (argument == "--replay")
+            options.replay_path = argv[++i];
+        else {
+            outln("Unknown option {}", argument);
+            return -1;
+        }
+    }
+
+    auto ast_h = read_file(std::filesystem::path { options.data_dir } / "AST.h");
+    auto ast_cpp = read_file(std::filesystem::path { options.data_dir } / "AST.cpp");
+
+    Bench bench(options);
+    outln("{:<44}{:>12}{:>12}", "benchmark", "median", "p95");
+    run_micro_benchmarks(bench, ast_h, ast_cpp);
+    run_end_to_end_benchmarks(bench, ast_h, ast_cpp);
+    if (!options.replay_path.empty())
+        run_replay_benchmark(bench, options.replay_path);
+
+    if (!options.json_path.empty())
+        write_json(options.json_path, bench.measurements());
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include "compile_commands.h"
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+#include <fmt/format.h>
+
+namespace {
+
+// Just enough of a JSON reader for compile_commands.json: every value that is
+// not a string or an array of strings is skipped.
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view json)
+        : m_json(json)
+    {
+    }
+
+    std::vector<CompileCommand> read_compile_commands()
+    {
+        std::vector<CompileCommand> commands;
+        expect('[');
+        if (consume_if(']'))
+            return commands;
+        do {
+            commands.push_back(read_compile_command());
+        } while (consume_if(','));
+        expect(']');
+        skip_whitespace();
+        if (m_position != m_json.size())
+            error("trailing characters");
+        return commands;
+    }
+
+private:
+    CompileCommand read_compile_command()
+    {
+        CompileCommand command;
+        std::string shell_command;
+        expect('{');
+        if (!consume_if('}')) {
+            do {
+                auto key = read_string();
+                expect(':');
+                if (key == "directory")
+                    command.directory = read_string();
+                else if (key == "file")
+                    command.file = read_string();
+                else if (key == "command")
+                    shell_command = read_string();
+                else if (key == "arguments")
+                    command.arguments = read_string_array();
+                else
+                    skip_value();
+            } while (consume_if(','));
+            expect('}');
+        }
+        if (command.arguments.empty())
+            command.arguments = split_command_line(shell_command);
+        if (command.file.empty())
+            error("entry without \"file\"");
+        return command;
+    }
+
+    std::vector<std::string> read_string_array()
+    {
+        std::vector<std::string> result;
+        expect('[');
+        if (consume_if(']'))
+            return result;
+        do {
+            result.push_back(read_string());
+        } while (consume_if(','));
+        expect(']');
+        return result;
+    }
+
+    std::string read_string()
+    {
+        expect('"');
+        std::string result;
+        while (true) {
+            if (m_position >= m_json.size())
+                error("unterminated string");
+            char c = m_json[m_position++];
+            if (c == '"')
+                return result;
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (m_position >= m_json.size())
+                error("unterminated escape");
+            switch (char escaped = m_json[m_position++]) {
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': append_utf8(result, read_hex4()); break;
+            default: result += escaped; break;
+            }
+        }
+    }
+
+    uint32_t read_hex4()
+    {
+        if (m_position + 4 > m_json.size())
+            error("truncated \\u escape");
+        uint32_t code_point = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = m_json[m_position++];
+            code_point <<= 4;
+            if (c >= '0' && c <= '9')
+                code_point |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                code_point |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                code_point |= c - 'A' + 10;
+            else
+                error("invalid \\u escape");
+        }
+        return code_point;
+    }
+
+    static void append_utf8(std::string& result, uint32_t code_point)
+    {
+        // Surrogate pairs only show up for characters outside of the BMP, which are
+        // not expected in paths. They are encoded as-is.
+        if (code_point < 0x80) {
+            result += static_cast<char>(code_point);
+        } else if (code_point < 0x800) {
+            result += static_cast<char>(0xc0 | (code_point >> 6));
+            result += static_cast<char>(0x80 | (code_point & 0x3f));
+        } else {
+            result += static_cast<char>(0xe0 | (code_point >> 12));
+            result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+            result += static_cast<char>(0x80 | (code_point & 0x3f));
+        }
+    }
+
+    void skip_value()
+    {
+        skip_whitespace();
+        if (m_position >= m_json.size())
+            error("unexpected end of input");
+        switch (m_json[m_position]) {
+        case '"':
+            read_string();
+            return;
+        case '[':
+            ++m_position;
+            if (consume_if(']'))
+                return;
+            do {
+                skip_value();
+            } while (consume_if(','));
+            expect(']');
+            return;
+        case '{':
+            ++m_position;
+            if (consume_if('}'))
+                return;
+            do {
+                read_string();
+                expect(':');
+                skip_value();
+            } while (consume_if(','));
+            expect('}');
+            return;
+        default:
+            // Numbers, true, false and null.
+            while (m_position < m_json.size() && (std::isalnum(static_cast<unsigned char>(m_json[m_position])) || m_json[m_position] == '-' || m_json[m_position] == '+' || m_json[m_position] == '.'))
+                ++m_position;
+            return;
+        }
+    }
+
+    void skip_whitespace()
+    {
+        while (m_position < m_json.size() && std::isspace(static_cast<unsigned char>(m_json[m_position])))
+            ++m_position;
+    }
+
+    bool consume_if(char c)
+    {
+        skip_whitespace();
+        if (m_position < m_json.size() && m_json[m_position] == c) {
+            ++m_position;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!consume_if(c))
+            error(fmt::format("expected '{}'", c));
+    }
+
+    [[noreturn]] void error(std::string const& message) const
+    {
+        throw std::runtime_error(fmt::format("compile_commands.json: {} at offset {}", message, m_position));
+    }
+
+    std::string_view m_json;
+    size_t m_position { 0 };
+};
+
+}
+
+std::vector<CompileCommand> parse_compile_commands(std::string_view json)
+{
+    return JsonReader(json).read_compile_commands();
+}
+
+std::vector<std::string> split_command_line(std::string_view command)
+{
+    std::vector<std::string> arguments;
+    std::string current;
+    bool in_argument = false;
+    for (size_t i = 0; i < command.size(); ++i) {
+        char c = command[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            if (in_argument)
+                arguments.push_back(std::move(current));
+            current.clear();
+            in_argument = false;
+            continue;
+        }
+        in_argument = true;
+        if (c == '\\' && i + 1 < command.size()) {
+            current += command[++i];
+        } else if (c == '\'') {
+            while (++i < command.size() && command[i] != '\'')
+                current += command[i];
+        } else if (c == '"') {
+            while (++i < command.size() && command[i] != '"') {
+                if (command[i] == '\\' && i + 1 < command.size() && (command[i + 1] == '"' || command[i + 1] == '\\'))
+                    ++i;
+                current += command[i];
+            }
+        } else {
+            current += c;
+        }
+    }
+    if (in_argument)
+        arguments.push_back(std::move(current));
+    return arguments;
+}
+
+std::string CompileCommand::absolute_file() const
+{
+    return (std::filesystem::path { directory } / file).lexically_normal().string();
+}
+
+std::vector<std::string> CompileCommand::include_directories() const
+{
+    static constexpr std::string_view include_flags[] = { "-I", "-iquote", "-isystem", "-idirafter" };
+
+    std::vector<std::string> result;
+    auto add = [&](std::string_view path) {
+        result.push_back((std::filesystem::path { directory } / path).lexically_normal().string());
+    };
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        std::string_view argument = arguments[i];
+        for (auto flag : include_flags) {
+            if (!argument.starts_with(flag))
+                continue;
+            if (argument.size() > flag.size())
+                add(argument.substr(flag.size()));
+            else if (i + 1 < arguments.size())
+                add(arguments[++i]);
+            break;
+        }
+    }
+    return result;
+}
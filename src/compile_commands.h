@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CompileCommand {
+    std::string directory;
+    std::string file;
+    std::vector<std::string> arguments;
+
+    std::string absolute_file() const;
+    // Absolute -I, -iquote, -isystem and -idirafter directories in command line order.
+    std::vector<std::string> include_directories() const;
+};
+
+// Parses the contents of a compile_commands.json file, entries that use
+// "command" instead of "arguments" are split like a shell would.
+// Throws std::runtime_error on malformed input.
+std::vector<CompileCommand> parse_compile_commands(std::string_view json);
+
+std::vector<std::string> split_command_line(std::string_view command);
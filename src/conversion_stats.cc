@@ -0,0 +1,294 @@
+#include "conversion_stats.h"
+#include <algorithm>
+#include <vector>
+#include <fmt/format.h>
+
+std::string_view phase_name(Phase phase) {
+    switch (phase) {
+    case Phase::Load: return "load";
+    case Phase::Tokenization: return "tokenization";
+    case Phase::SemanticLookup: return "semantic lookup";
+    case Phase::Rewriting: return "rewriting";
+    case Phase::Output: return "output";
+    }
+    return "unknown";
+}
+
+ConversionStats::Scope::Scope(ConversionStats* stats, Phase phase)
+    : m_stats(stats)
+{
+    if (!m_stats)
+        return;
+    m_previous_phase = m_stats->m_current_phase;
+    m_stats->switch_to(phase);
+}
+
+ConversionStats::Scope::~Scope() {
+    if (m_stats)
+        m_stats->switch_to(m_previous_phase);
+}
+
+ConversionStats::FileScope::FileScope(ConversionStats* stats, std::string_view file_path)
+    : m_stats(allocation_counting_enabled ? stats : nullptr)
+{
+    if (!m_stats)
+        return;
+    m_previous_file = m_stats->m_current_file;
+    auto it = m_stats->m_file_allocations.find(file_path);
+    if (it == m_stats->m_file_allocations.end())
+        it = m_stats->m_file_allocations.emplace(std::string { file_path }, AllocationCounters {}).first;
+    m_stats->switch_to_file(&it->second);
+}
+
+ConversionStats::FileScope::~FileScope() {
+    if (m_stats)
+        m_stats->switch_to_file(m_previous_file);
+}
+
+void ConversionStats::switch_to_file(AllocationCounters* file) {
+    auto counters = thread_allocation_counters();
+    if (m_current_file)
+        *m_current_file += counters - m_allocations_at_file_start;
+    m_current_file = file;
+    m_allocations_at_file_start = counters;
+}
+
+void ConversionStats::switch_to(std::optional<Phase> phase) {
+    auto now = Clock::now();
+    if (m_current_phase)
+        m_phase_times[static_cast<size_t>(*m_current_phase)] += now - m_phase_start;
+
+    if (m_perf_counters) {
+        auto counters = m_perf_counters->read();
+        if (m_current_phase) {
+            auto& phase_counters = m_phase_counters[static_cast<size_t>(*m_current_phase)];
+            for (size_t i = 0; i < hardware_counter_count; ++i)
+                phase_counters[i] += counters[i] - m_counters_at_phase_start[i];
+        }
+        m_counters_at_phase_start = counters;
+    }
+
+    if constexpr (allocation_counting_enabled) {
+        auto counters = thread_allocation_counters();
+        if (m_current_phase)
+            m_phase_allocations[static_cast<size_t>(*m_current_phase)] += counters - m_allocations_at_phase_start;
+        m_allocations_at_phase_start = counters;
+    }
+
+    m_current_phase = phase;
+    m_phase_start = now;
+}
+
+void ConversionStats::enable_hardware_counters() {
+    m_perf_counters = std::make_unique<PerfCounters>();
+    m_has_hardware_counters = true;
+    m_counters_at_phase_start = m_perf_counters->read();
+}
+
+RuleCounters& ConversionStats::rule(std::string_view name) {
+    auto it = m_rules.find(name);
+    if (it == m_rules.end())
+        it = m_rules.emplace(std::string { name }, RuleCounters {}).first;
+    return it->second;
+}
+
+void ConversionStats::record_footprint(MemoryFootprint const& footprint) {
+    if (footprint.total() > m_peak_footprint.total())
+        m_peak_footprint = footprint;
+}
+
+void ConversionStats::merge(ConversionStats const& other) {
+    merge_phase_times(other);
+    files += other.files;
+    textual_files += other.textual_files;
+    copied_files += other.copied_files;
+    cached_lines += other.cached_lines;
+    lines += other.lines;
+    bytes += other.bytes;
+    for (auto const& [name, counters] : other.m_rules) {
+        auto& merged = rule(name);
+        merged.fired += counters.fired;
+        merged.replacements += counters.replacements;
+        merged.semantic_queries += counters.semantic_queries;
+        merged.symbol_lookups += counters.symbol_lookups;
+    }
+    for (auto const& [name, counters] : other.m_file_allocations) {
+        auto it = m_file_allocations.find(name);
+        if (it == m_file_allocations.end())
+            m_file_allocations.emplace(name, counters);
+        else
+            it->second += counters;
+    }
+    m_peak_footprint.source_bytes += other.m_peak_footprint.source_bytes;
+    m_peak_footprint.token_bytes += other.m_peak_footprint.token_bytes;
+    m_peak_footprint.engine_bytes += other.m_peak_footprint.engine_bytes;
+}
+
+void ConversionStats::merge_phase_times(ConversionStats const& other) {
+    for (size_t i = 0; i < phase_count; ++i) {
+        m_phase_times[i] += other.m_phase_times[i];
+        for (size_t j = 0; j < hardware_counter_count; ++j)
+            m_phase_counters[i][j] += other.m_phase_counters[i][j];
+        m_phase_allocations[i] += other.m_phase_allocations[i];
+    }
+    m_has_hardware_counters |= other.m_has_hardware_counters;
+}
+
+void ConversionStats::reset() {
+    files = 0;
+    textual_files = 0;
+    copied_files = 0;
+    cached_lines = 0;
+    lines = 0;
+    bytes = 0;
+    m_phase_times = {};
+    m_phase_counters = {};
+    m_rules.clear();
+    m_phase_allocations = {};
+    m_peak_footprint = {};
+    m_file_allocations.clear();
+}
+
+static double milliseconds(std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static double mebibytes(double bytes) {
+    return bytes / (1024 * 1024);
+}
+
+// The files that allocated the most bytes first.
+static std::vector<std::pair<std::string_view, AllocationCounters>> files_by_allocated_bytes(std::map<std::string, AllocationCounters, std::less<>> const& files) {
+    std::vector<std::pair<std::string_view, AllocationCounters>> result(files.begin(), files.end());
+    std::stable_sort(result.begin(), result.end(), [](auto const& a, auto const& b) {
+        return a.second.bytes > b.second.bytes;
+    });
+    return result;
+}
+
+std::string json_string(std::string_view text) {
+    std::string result = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                result += fmt::format("\\u{:04x}", c);
+            else
+                result += c;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+std::string ConversionStats::to_text() const {
+    std::string result = fmt::format("{} files ({} without tokens), {} lines ({} from the line cache), {} bytes, {} files copied unchanged\n\n", files, textual_files, lines, cached_lines, bytes, copied_files);
+
+    std::chrono::nanoseconds total {};
+    result += fmt::format("{:<20}{:>12}\n", "phase", "time (ms)");
+    for (size_t i = 0; i < phase_count; ++i) {
+        result += fmt::format("{:<20}{:>12.3f}\n", phase_name(static_cast<Phase>(i)), milliseconds(m_phase_times[i]));
+        total += m_phase_times[i];
+    }
+    result += fmt::format("{:<20}{:>12.3f}\n\n", "total", milliseconds(total));
+
+    if (m_has_hardware_counters) {
+        result += fmt::format("{:<20}", "phase");
+        for (size_t i = 0; i < hardware_counter_count; ++i)
+            result += fmt::format("{:>16}", hardware_counter_name(static_cast<HardwareCounter>(i)));
+        result += fmt::format("{:>8}\n", "IPC");
+        for (size_t i = 0; i < phase_count; ++i) {
+            auto const& counters = m_phase_counters[i];
+            result += fmt::format("{:<20}", phase_name(static_cast<Phase>(i)));
+            for (auto value : counters)
+                result += fmt::format("{:>16}", value);
+            auto cycles = counters[static_cast<size_t>(HardwareCounter::Cycles)];
+            auto instructions = counters[static_cast<size_t>(HardwareCounter::Instructions)];
+            result += fmt::format("{:>8.2f}\n", cycles ? static_cast<double>(instructions) / cycles : 0.0);
+        }
+        result += '\n';
+    }
+
+    result += fmt::format("peak RSS {:.1f} MiB\n", mebibytes(peak_rss_bytes()));
+    result += fmt::format("{:<20}{:>12}\n", "largest footprint", "MiB");
+    result += fmt::format("{:<20}{:>12.2f}\n", "source", mebibytes(m_peak_footprint.source_bytes));
+    result += fmt::format("{:<20}{:>12.2f}\n", "tokens", mebibytes(m_peak_footprint.token_bytes));
+    result += fmt::format("{:<20}{:>12.2f}{}\n", "engine", mebibytes(m_peak_footprint.engine_bytes), allocation_counting_enabled ? "" : " (estimated)");
+    result += fmt::format("{:<20}{:>12.2f}\n\n", "total", mebibytes(m_peak_footprint.total()));
+
+    if constexpr (allocation_counting_enabled) {
+        result += fmt::format("{:<20}{:>14}{:>18}{:>14}\n", "phase", "allocations", "allocated MiB", "live MiB");
+        for (size_t i = 0; i < phase_count; ++i) {
+            auto const& counters = m_phase_allocations[i];
+            result += fmt::format("{:<20}{:>14}{:>18.2f}{:>14.2f}\n", phase_name(static_cast<Phase>(i)),
+                counters.allocations, mebibytes(counters.bytes), mebibytes(counters.live_bytes()));
+        }
+        result += '\n';
+
+        static constexpr size_t files_shown = 10;
+        auto files = files_by_allocated_bytes(m_file_allocations);
+        result += fmt::format("{:<40}{:>14}{:>18}{:>14}\n", "file", "allocations", "allocated MiB", "live MiB");
+        for (size_t i = 0; i < std::min(files.size(), files_shown); ++i) {
+            auto const& [name, counters] = files[i];
+            result += fmt::format("{:<40}{:>14}{:>18.2f}{:>14.2f}\n", name,
+                counters.allocations, mebibytes(counters.bytes), mebibytes(counters.live_bytes()));
+        }
+        if (files.size() > files_shown)
+            result += fmt::format("... and {} more files\n", files.size() - files_shown);
+        result += '\n';
+    }
+
+    result += fmt::format("{:<28}{:>10}{:>14}{:>18}{:>16}\n", "rule", "fired", "replacements", "semantic queries", "from symbols");
+    for (auto const& [name, counters] : m_rules)
+        result += fmt::format("{:<28}{:>10}{:>14}{:>18}{:>16}\n", name, counters.fired, counters.replacements, counters.semantic_queries, counters.symbol_lookups);
+    return result;
+}
+
+std::string ConversionStats::to_json() const {
+    std::string result = fmt::format("{{\n  \"files\": {},\n  \"textual_files\": {},\n  \"copied_files\": {},\n  \"lines\": {},\n  \"cached_lines\": {},\n  \"bytes\": {},\n  \"phases_ms\": {{", files, textual_files, copied_files, lines, cached_lines, bytes);
+    for (size_t i = 0; i < phase_count; ++i)
+        result += fmt::format("{}\n    {}: {:.3f}", i ? "," : "", json_string(phase_name(static_cast<Phase>(i))), milliseconds(m_phase_times[i]));
+    result += "\n  },";
+    if (m_has_hardware_counters) {
+        result += "\n  \"hardware_counters\": {";
+        for (size_t i = 0; i < phase_count; ++i) {
+            result += fmt::format("{}\n    {}: {{", i ? "," : "", json_string(phase_name(static_cast<Phase>(i))));
+            for (size_t j = 0; j < hardware_counter_count; ++j)
+                result += fmt::format("{} {}: {}", j ? "," : "", json_string(hardware_counter_name(static_cast<HardwareCounter>(j))), m_phase_counters[i][j]);
+            result += " }";
+        }
+        result += "\n  },";
+    }
+    result += fmt::format("\n  \"peak_rss_bytes\": {},", peak_rss_bytes());
+    result += fmt::format("\n  \"largest_footprint\": {{ \"source_bytes\": {}, \"token_bytes\": {}, \"engine_bytes\": {}, \"engine_bytes_estimated\": {} }},",
+        m_peak_footprint.source_bytes, m_peak_footprint.token_bytes, m_peak_footprint.engine_bytes, !allocation_counting_enabled);
+    if constexpr (allocation_counting_enabled) {
+        result += "\n  \"allocations\": {";
+        for (size_t i = 0; i < phase_count; ++i) {
+            auto const& counters = m_phase_allocations[i];
+            result += fmt::format("{}\n    {}: {{ \"allocations\": {}, \"bytes\": {}, \"live_bytes\": {} }}", i ? "," : "",
+                json_string(phase_name(static_cast<Phase>(i))), counters.allocations, counters.bytes, counters.live_bytes());
+        }
+        result += "\n  },\n  \"file_allocations\": [";
+        bool first_file = true;
+        for (auto const& [name, counters] : files_by_allocated_bytes(m_file_allocations)) {
+            result += fmt::format("{}\n    {{ \"file\": {}, \"allocations\": {}, \"bytes\": {}, \"live_bytes\": {} }}", first_file ? "" : ",",
+                json_string(name), counters.allocations, counters.bytes, counters.live_bytes());
+            first_file = false;
+        }
+        result += "\n  ],";
+    }
+    result += "\n  \"rules\": [";
+    bool first = true;
+    for (auto const& [name, counters] : m_rules) {
+        result += fmt::format("{}\n    {{ \"rule\": {}, \"fired\": {}, \"replacements\": {}, \"semantic_queries\": {}, \"symbol_lookups\": {} }}",
+            first ? "" : ",", json_string(name), counters.fired, counters.replacements, counters.semantic_queries, counters.symbol_lookups);
+        first = false;
+    }
+    result += "\n  ]\n}\n";
+    return result;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "allocation_counters.h"
+#include "perf_counters.h"
+
+enum class Phase : uint8_t {
+    Load,
+    Tokenization,
+    SemanticLookup,
+    Rewriting,
+    Output,
+};
+inline constexpr size_t phase_count = 5;
+std::string_view phase_name(Phase phase);
+
+// `text` as a quoted and escaped JSON string.
+std::string json_string(std::string_view text);
+
+struct RuleCounters {
+    // How often the rule's contains() check matched a line.
+    uint64_t fired { 0 };
+    uint64_t replacements { 0 };
+    uint64_t semantic_queries { 0 };
+    // The semantic queries that the SymbolDatabase and the AkTypeModel
+    // answered, possibly with the engine's help for the head of a chain.
+    uint64_t symbol_lookups { 0 };
+};
+
+// What a converter holds in memory: the source (as a buffer, as lines and the
+// engine's copy), the packed tokens, and the engine's own data.
+struct MemoryFootprint {
+    size_t source_bytes { 0 };
+    size_t token_bytes { 0 };
+    size_t engine_bytes { 0 };
+
+    size_t total() const { return source_bytes + token_bytes + engine_bytes; }
+};
+
+// Where the time (and, with allocation counting, the memory) of a conversion
+// goes, and what every rewrite rule did.
+// Not thread safe, give every thread its own instance and merge() them.
+class ConversionStats {
+public:
+    // Charges the time until it is destroyed to `phase`. Scopes nest, the time
+    // of an inner scope is not charged to the outer one. Does nothing if
+    // `stats` is null.
+    class Scope {
+    public:
+        Scope(ConversionStats* stats, Phase phase);
+        ~Scope();
+
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        ConversionStats* m_stats;
+        std::optional<Phase> m_previous_phase;
+    };
+
+    // Charges the allocations until it is destroyed to `file_path`, nesting
+    // like Scope. Does nothing without allocation counting.
+    class FileScope {
+    public:
+        FileScope(ConversionStats* stats, std::string_view file_path);
+        ~FileScope();
+
+        FileScope(FileScope const&) = delete;
+        FileScope& operator=(FileScope const&) = delete;
+
+    private:
+        ConversionStats* m_stats;
+        AllocationCounters* m_previous_file { nullptr };
+    };
+
+    // Also counts cycles, instructions, cache and branch misses per phase.
+    // The counters belong to the calling thread, the stats must not be used
+    // from another one. Throws std::runtime_error if they can't be opened.
+    void enable_hardware_counters();
+    bool has_hardware_counters() const { return m_has_hardware_counters; }
+
+    RuleCounters& rule(std::string_view name);
+    // Keeps the largest footprint reported.
+    void record_footprint(MemoryFootprint const& footprint);
+    void merge(ConversionStats const& other);
+    // Only the phase times of `other`, for work whose rule counts would be
+    // counted twice.
+    void merge_phase_times(ConversionStats const& other);
+    // Clears all numbers, hardware counters stay enabled.
+    void reset();
+
+    std::chrono::nanoseconds phase_time(Phase phase) const { return m_phase_times[static_cast<size_t>(phase)]; }
+
+    std::string to_text() const;
+    std::string to_json() const;
+
+    uint64_t files { 0 };
+    // Files converted without tokens, no rule that needs them could fire.
+    uint64_t textual_files { 0 };
+    // Files copied to the output as they are, not counted in `files`.
+    uint64_t copied_files { 0 };
+    // Lines taken from a LineCache.
+    uint64_t cached_lines { 0 };
+    uint64_t lines { 0 };
+    uint64_t bytes { 0 };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void switch_to(std::optional<Phase> phase);
+    void switch_to_file(AllocationCounters* file);
+
+    std::array<std::chrono::nanoseconds, phase_count> m_phase_times {};
+    std::optional<Phase> m_current_phase;
+    Clock::time_point m_phase_start;
+    std::map<std::string, RuleCounters, std::less<>> m_rules;
+
+    std::unique_ptr<PerfCounters> m_perf_counters;
+    bool m_has_hardware_counters { false };
+    std::array<HardwareCounterValues, phase_count> m_phase_counters {};
+    HardwareCounterValues m_counters_at_phase_start {};
+
+    std::array<AllocationCounters, phase_count> m_phase_allocations {};
+    AllocationCounters m_allocations_at_phase_start {};
+    std::map<std::string, AllocationCounters, std::less<>> m_file_allocations;
+    AllocationCounters* m_current_file { nullptr };
+    AllocationCounters m_allocations_at_file_start {};
+    // Merged stats add up the footprints, their converters ran side by side.
+    MemoryFootprint m_peak_footprint;
+};
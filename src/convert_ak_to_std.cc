@@ -0,0 +1,1486 @@
+#include "convert_ak_to_std.h"
+#include "lexer.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+bool contains(std::string_view str, std::string_view text) {
+    std::size_t pos = str.find(text);
+    if(pos == std::string_view::npos)
+        return false;
+    return true;
+}
+
+std::optional<PackedTokens::size_type> find_token_index(
+        int row
+        , int column
+        , PackedTokens const& vec_token_info)
+{
+    auto const line = static_cast<uint32_t>(row);
+    auto const col = static_cast<uint32_t>(column);
+    for(PackedTokens::size_type i = 0; i < vec_token_info.size(); ++i) {
+        auto const& token_info = vec_token_info[i];
+        if(line >= token_info.start_line && line <= token_info.end_line) {
+            if(line == token_info.start_line) {
+                if(col < token_info.start_column)
+                    continue;
+            }
+            if(line == token_info.end_line) {
+                if(col > token_info.end_column)
+                    continue;
+            }
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string to_string(PackedToken const& token_info) {
+    std::string result="[row: ";
+    result+= std::to_string(token_info.start_line);
+    result+= ", col: ";
+    result+= std::to_string(token_info.start_column);
+    result+= "] -> [row: ";
+    result+= std::to_string(token_info.end_line);
+    result+= ", col: ";
+    result+= std::to_string(token_info.end_column);
+    result+= "]";
+    return result;
+}
+
+std::vector<std::string> split_into_lines(std::string_view content) {
+    std::vector<std::string> lines;
+    while (!content.empty()) {
+        auto end_pos = content.find('\n');
+        if (end_pos == std::string_view::npos) {
+            lines.emplace_back(content);
+            break;
+        }
+        lines.emplace_back(content.substr(0, end_pos));
+        content.remove_prefix(end_pos + 1);
+    }
+    return lines;
+}
+
+void ConvertAkToStd::add_include_filepath_for_output(std::string include_path) {
+    m_include_path = std::move(include_path);
+    m_own_include_rewriter.reset();
+}
+
+void ConvertAkToStd::add_file(std::string const& file_path, std::string_view content) {
+    ConversionStats::FileScope file_scope(m_stats, file_path);
+    ConversionStats::Scope scope(m_stats, Phase::Load);
+    TRACE_SPAN("load", "add_file", file_path);
+    auto existing_file = file_id(file_path);
+    FileId file;
+    if (existing_file) {
+        file = *existing_file;
+    } else {
+        file = static_cast<FileId>(m_files.size());
+        m_files.emplace_back().name = file_path;
+        m_file_ids.emplace(file_path, file);
+    }
+
+    auto& state = m_files[file];
+    state.content_as_lines = split_into_lines(content);
+    state.content_as_string.clear();
+    for(auto const& line : state.content_as_lines) {
+        state.content_as_string+=line + "\n";
+    }
+    state.tokens.clear();
+    state.has_tokens = false;
+    state.needs_tokens.reset();
+    state.is_resident = true;
+    mark_used(file);
+    update_resident_bytes(state);
+
+    filedb.add(file_path, std::string{content});
+    if (existing_file && engine) {
+        auto allocations_before = thread_allocation_counters();
+        engine->on_edit(file_path);
+        charge_engine_allocations(allocations_before);
+        if (m_query_recorder)
+            m_query_recorder->file_edited(m_query_stream, file_path);
+    }
+}
+
+bool ConvertAkToStd::has_file(std::string const& file_path) const {
+    return m_file_ids.contains(file_path);
+}
+
+void ConvertAkToStd::remove_file(std::string const& file_path) {
+    // The engine can't be told that a file is gone, and its parse trees of
+    // other files may still refer to it, also if it was only read as an
+    // #include and never added.
+    if (engine && m_engine_files.contains(file_path))
+        drop_engine();
+    auto file = file_id(file_path);
+    if (!file)
+        return;
+    auto& state = m_files[*file];
+    evict(state);
+    if (engine && state.parsed_by_engine)
+        drop_engine();
+    // FileIds are not reused, the state stays behind without a name.
+    state.name.clear();
+    state.needs_tokens.reset();
+    state.is_pinned = false;
+    m_file_ids.erase(file_path);
+}
+
+std::optional<FileId> ConvertAkToStd::file_id(std::string const& file_path) const {
+    auto it = m_file_ids.find(file_path);
+    if (it == m_file_ids.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void ConvertAkToStd::set_memory_budget(size_t bytes) {
+    m_memory_budget = bytes;
+    enforce_memory_budget();
+}
+
+void ConvertAkToStd::set_file_loader(LocalFileDB::Loader loader) {
+    m_file_loader = loader;
+    filedb.set_loader(std::move(loader));
+}
+
+void ConvertAkToStd::set_pinned_files(std::vector<std::string> const& file_paths) {
+    for (auto& state : m_files)
+        state.is_pinned = false;
+    for (auto const& file_path : file_paths) {
+        if (auto file = file_id(file_path))
+            m_files[*file].is_pinned = true;
+    }
+    enforce_memory_budget();
+}
+
+ConvertAkToStd::FileState& ConvertAkToStd::resident(FileId file) {
+    auto& state = m_files[file];
+    mark_used(file);
+    if (state.is_resident)
+        return state;
+
+    ConversionStats::FileScope file_scope(m_stats, state.name);
+    ConversionStats::Scope scope(m_stats, Phase::Load);
+    TRACE_SPAN("load", "reload", state.name);
+    auto content = m_file_loader(state.name);
+    if (!content)
+        throw std::runtime_error(fmt::format("unable to reload evicted file {}", state.name));
+    state.content_as_lines = split_into_lines(*content);
+    for(auto const& line : state.content_as_lines) {
+        state.content_as_string+=line + "\n";
+    }
+    state.is_resident = true;
+    update_resident_bytes(state);
+    return state;
+}
+
+void ConvertAkToStd::update_resident_bytes(FileState& state) {
+    size_t token_bytes = state.tokens.capacity() * sizeof(PackedToken);
+    size_t bytes = state.content_as_string.capacity()
+        + state.content_as_lines.capacity() * sizeof(std::string)
+        + token_bytes;
+    for (auto const& line : state.content_as_lines)
+        bytes += line.capacity();
+    // The filedb keeps another copy of the content for the engine.
+    bytes += state.content_as_string.size();
+
+    m_resident_bytes = m_resident_bytes - state.resident_bytes + bytes;
+    state.resident_bytes = bytes;
+    m_token_bytes = m_token_bytes - state.token_bytes + token_bytes;
+    state.token_bytes = token_bytes;
+}
+
+void ConvertAkToStd::mark_used(FileId file) {
+    auto& state = m_files[file];
+    if (!state.lru_position)
+        state.lru_position = m_lru_files.insert(m_lru_files.end(), file);
+    else if (std::next(*state.lru_position) != m_lru_files.end())
+        m_lru_files.splice(m_lru_files.end(), m_lru_files, *state.lru_position);
+}
+
+void ConvertAkToStd::evict(FileState& state) {
+    dbgln("evicting {}", state.name);
+    state.content_as_string = {};
+    state.content_as_lines = {};
+    state.tokens = {};
+    state.has_tokens = false;
+    state.class_scopes.reset();
+    state.is_resident = false;
+    if (state.lru_position) {
+        m_lru_files.erase(*state.lru_position);
+        state.lru_position.reset();
+    }
+    filedb.remove(state.name);
+    update_resident_bytes(state);
+}
+
+void ConvertAkToStd::enforce_memory_budget() {
+    if (!m_memory_budget || !m_file_loader)
+        return;
+
+    for (auto next = m_lru_files.begin(); next != m_lru_files.end() && estimated_memory_usage() > m_memory_budget;) {
+        auto& state = m_files[*next];
+        // Evicting the file takes it out of the list.
+        ++next;
+        if (!state.is_pinned)
+            evict(state);
+    }
+
+    // Parse trees can't be dropped one file at a time, so start over with a fresh engine.
+    if (estimated_memory_usage() > m_memory_budget && engine)
+        drop_engine();
+}
+
+void ConvertAkToStd::drop_engine() {
+    dbgln("dropping the comprehension engine ({} bytes estimated)", m_engine_bytes);
+    engine.reset();
+    m_engine_bytes = 0;
+    m_engine_files.clear();
+    for (auto& state : m_files)
+        state.parsed_by_engine = false;
+}
+
+
+std::set<std::string> ConvertAkToStd::included_files(std::string const& file_path) {
+    std::set<std::string> result;
+    auto directory = std::filesystem::path{file_path}.parent_path();
+    auto file = file_id(file_path);
+    if (!file)
+        return result;
+    for (auto const& line : resident(*file).content_as_lines) {
+        if (!line.starts_with("#include \""))
+            continue;
+        auto end_pos = line.find_last_of('"');
+        if (end_pos < strlen("#include \""))
+            continue;
+        std::string included{line.begin() + strlen("#include \""), line.begin() + end_pos};
+        auto relative_to_file = (directory / included).lexically_normal().string();
+        if (has_file(relative_to_file))
+            result.insert(relative_to_file);
+        else if (has_file(included))
+            result.insert(included);
+    }
+    return result;
+}
+
+std::set<std::string> ConvertAkToStd::files_depending_on(std::string const& file_path) {
+    std::map<std::string, std::set<std::string>> included_by;
+    for (auto const& file : m_files) {
+        for (auto const& included : included_files(file.name))
+            included_by[included].insert(file.name);
+    }
+
+    std::set<std::string> result;
+    std::vector<std::string> pending { file_path };
+    while (!pending.empty()) {
+        auto current = pending.back();
+        pending.pop_back();
+        for (auto const& includer : included_by[current]) {
+            if (result.insert(includer).second)
+                pending.push_back(includer);
+        }
+    }
+    result.erase(file_path);
+    return result;
+}
+
+bool ConvertAkToStd::needs_tokens(FileId file) {
+    auto& state = resident(file);
+    if (!state.needs_tokens) {
+        state.needs_tokens = std::ranges::any_of(RuleSet::code_rules(), [&](auto const& rule) {
+            return rule.needs_tokens && contains(state.content_as_string, rule.anchor);
+        });
+    }
+    return *state.needs_tokens;
+}
+
+PackedTokens const& ConvertAkToStd::tokens_for(FileId file) {
+    auto& state = resident(file);
+    if (!state.has_tokens) {
+        // The rules only need token boundaries, which the built-in lexer
+        // provides without parsing. The engine is only asked for declarations.
+        ConversionStats::Scope scope(m_stats, Phase::Tokenization);
+        TRACE_SPAN("lex", "lex file", state.name);
+        state.tokens.clear();
+        state.class_scopes.reset();
+        LexState lex_state = LexState::Code;
+        for (size_t row = 0; row < state.content_as_lines.size(); ++row)
+            lex_line(state.content_as_lines[row], row, lex_state, state.tokens);
+        state.has_tokens = true;
+        update_resident_bytes(state);
+    }
+    return state.tokens;
+}
+
+CodeComprehension::Cpp::CppComprehensionEngine& ConvertAkToStd::engine_for(FileId file) {
+    auto& state = m_files[file];
+    if (!state.parsed_by_engine) {
+        // Without allocation counting, a rough estimate of what the engine keeps per source byte (tokens, AST and declarations).
+        static constexpr size_t engine_bytes_per_source_byte = 16;
+        if (!allocation_counting_enabled)
+            m_engine_bytes += state.content_as_string.size() * engine_bytes_per_source_byte;
+        state.parsed_by_engine = true;
+    }
+    return ensure_engine();
+}
+
+
+void ConvertAkToStd::set_stats(ConversionStats* stats) {
+    m_stats = stats;
+}
+
+void ConvertAkToStd::set_rules(RuleSet const* rules) {
+    m_rules = rules ? rules : &RuleSet::built_in();
+    m_own_include_rewriter.reset();
+}
+
+void ConvertAkToStd::set_line_cache(LineCache* cache) {
+    m_line_cache = cache;
+}
+
+void ConvertAkToStd::set_symbol_database(SymbolDatabase const* database) {
+    m_symbol_database = database;
+}
+
+void ConvertAkToStd::set_include_rewriter(IncludeRewriter* rewriter) {
+    m_include_rewriter = rewriter;
+}
+
+IncludeRewriter& ConvertAkToStd::include_rewriter() {
+    if (m_include_rewriter)
+        return *m_include_rewriter;
+    if (!m_own_include_rewriter)
+        m_own_include_rewriter = std::make_unique<IncludeRewriter>(*m_rules, m_include_path);
+    return *m_own_include_rewriter;
+}
+
+void ConvertAkToStd::set_query_recorder(EngineQueryRecorder* recorder) {
+    m_query_recorder = recorder;
+    if (!m_query_recorder)
+        return;
+    m_query_stream = m_query_recorder->new_stream();
+    if (engine)
+        m_query_recorder->engine_created(m_query_stream);
+}
+
+void ConvertAkToStd::on_engine_read(std::string const& path, std::string const& content) {
+    m_engine_files.insert(path);
+    if (m_query_recorder)
+        m_query_recorder->file_read(m_query_stream, path, content);
+}
+
+CodeComprehension::Cpp::CppComprehensionEngine& ConvertAkToStd::ensure_engine() {
+    if (!engine) {
+        filedb.set_read_observer([this](std::string const& path, std::string const& content) {
+            on_engine_read(path, content);
+        });
+        auto allocations_before = thread_allocation_counters();
+        engine = std::make_unique<CodeComprehension::Cpp::CppComprehensionEngine>(filedb);
+        charge_engine_allocations(allocations_before);
+        if (m_query_recorder)
+            m_query_recorder->engine_created(m_query_stream);
+    }
+    return *engine;
+}
+
+void ConvertAkToStd::charge_engine_allocations(AllocationCounters const& before, size_t returned_bytes) {
+    if constexpr (allocation_counting_enabled) {
+        auto kept = (thread_allocation_counters() - before).live_bytes() - static_cast<int64_t>(returned_bytes);
+        m_engine_bytes = static_cast<size_t>(std::max<int64_t>(0, static_cast<int64_t>(m_engine_bytes) + kept));
+    }
+}
+
+void ConvertAkToStd::record_footprint() {
+    if (m_stats)
+        m_stats->record_footprint(memory_footprint());
+}
+
+void ConvertAkToStd::begin_rule(std::string_view name) {
+    m_current_rule = { m_stats ? &m_stats->rule(name) : nullptr };
+    if (!m_current_rule.counters)
+        return;
+    m_current_rule.counters->fired++;
+    if (m_recorded_rules) {
+        m_current_rule.hit = m_recorded_rules->size();
+        m_recorded_rules->push_back({ std::string { name } });
+    }
+}
+
+bool ConvertAkToStd::rule_matches(std::string_view line, RuleSet::CodeRule rule) {
+    auto const& code_rule = RuleSet::code_rule(rule);
+    if (!contains(line, code_rule.anchor))
+        return false;
+    begin_rule(code_rule.anchor);
+    if (code_rule.needs_tokens)
+        m_line_uses_tokens = true;
+    return true;
+}
+
+void ConvertAkToStd::count_rewrites(size_t replacements) {
+    if (!m_current_rule.counters)
+        return;
+    m_current_rule.counters->replacements += replacements;
+    if (m_recorded_rules)
+        (*m_recorded_rules)[m_current_rule.hit].replacements += replacements;
+}
+
+void ConvertAkToStd::rewrite(std::pmr::string& line, std::string_view text_to_replace, std::string_view replacement) {
+    count_rewrites(replace(line, text_to_replace, replacement));
+}
+
+void ConvertAkToStd::count_rewrite() {
+    count_rewrites(1);
+}
+
+ConvertAkToStd::FileArena::FileArena(ConvertAkToStd& converter, size_t expected_size)
+    : m_converter(converter)
+{
+    if (converter.m_arena_buffer.size() < expected_size)
+        converter.m_arena_buffer.resize(expected_size);
+    m_resource.emplace(converter.m_arena_buffer.data(), converter.m_arena_buffer.size());
+    converter.m_arena = &*m_resource;
+}
+
+ConvertAkToStd::FileArena::~FileArena()
+{
+    m_converter.m_arena = std::pmr::get_default_resource();
+}
+
+std::pmr::string ConvertAkToStd::get_token_string(FileId file, PackedToken const &token_info) {
+    auto const& content = resident(file).content_as_lines;
+    std::pmr::string result { m_arena };
+    bool first_line = true;
+
+    for (uint32_t i = token_info.start_line; i <= token_info.end_line; ++i) {
+        if (!first_line)  // The first line should not start with a newline
+            result += "\n";
+        else
+            first_line = false;
+
+        int start_col = 0, end_col = content[i].size() - 1;
+        if (i == token_info.start_line) {
+            start_col = token_info.start_column;
+        }
+        if (i == token_info.end_line) {
+            end_col = token_info.end_column;
+        }
+
+        result.append(content[i], start_col, end_col - start_col + 1);
+    }
+    return result;
+}
+
+std::pmr::string ConvertAkToStd::token_string (FileId file, int token_index, PackedTokens const &tiv) {
+    return get_token_string(file, tiv[token_index]);
+}
+
+std::optional<std::pmr::string>  ConvertAkToStd::object_text(FileId file, int line, int position,
+                                       PackedTokens const &tiv)
+{
+    // This is the method call
+    auto tok_index_opt = find_token_index(line, position, tiv);
+    if (!tok_index_opt.has_value()) return std::nullopt;
+
+    // This is the . or the -> character
+    auto token_index = tok_index_opt.value();
+    if (token_index < 2) return std::nullopt;
+    auto prev_token = get_token_string(file, tiv[token_index - 1]);
+    if (prev_token != "." && prev_token != "->") return std::nullopt;
+
+    // This is the object text
+    auto object_text = get_token_string(file, tiv[token_index - 2]);
+    return object_text;
+}
+
+std::optional<std::pmr::string> ConvertAkToStd::find_parent_token_type(FileId file, int line, int position,
+         PackedTokens const &tiv) {
+    if (!m_files[file].has_semantics)
+        return std::nullopt;
+
+    auto tok_index = find_token_index(line, position, tiv);
+    if (tok_index && tok_index.value() >= 2) {
+        auto token_index = tok_index.value();
+        auto prev_token = get_token_string(file, tiv[token_index - 1]);
+        if (prev_token == "." || prev_token == "->") {
+            auto const &prev_prev_token = tiv[token_index - 2];
+            if (m_current_rule.counters)
+                m_current_rule.counters->semantic_queries++;
+            if (auto type = expression_type(file, token_index - 2, tiv, false)) {
+                auto object_type = prev_token == "->" ? arrow_type(*type) : type;
+                if (object_type) {
+                    if (m_current_rule.counters)
+                        m_current_rule.counters->symbol_lookups++;
+                    return std::pmr::string { ParsedType::parse(*object_type).name, m_arena };
+                }
+            }
+            return declared_type_from_engine(file, prev_prev_token);
+        }
+    } else {
+        dbgln("find_token_index({}, {}): std::nullopt", line, position);
+    }
+    return std::nullopt;
+}
+
+std::optional<std::pmr::string> ConvertAkToStd::declared_type_from_engine(FileId file, PackedToken const& token) {
+    ConversionStats::Scope scope(m_stats, Phase::SemanticLookup);
+    TRACE_SPAN("semantic", "find_declaration_of", m_files[file].name);
+    auto& comprehension_engine = engine_for(file);
+    auto allocations_before = thread_allocation_counters();
+    auto parent_token = comprehension_engine.find_declaration_of(m_files[file].name, {token.start_line,
+                                                              token.start_column});
+    charge_engine_allocations(allocations_before);
+    if (m_query_recorder)
+        m_query_recorder->declaration(m_query_stream, m_files[file].name, token.start_line, token.start_column, parent_token);
+    auto parent_file = parent_token.has_value() ? file_id(parent_token.value().file) : std::nullopt;
+    if (parent_file.has_value()) {
+        auto tok_index_opt = find_token_index(parent_token.value().line, parent_token.value().column,
+                                              tokens_for(*parent_file));
+        if (tok_index_opt.has_value()) {
+            auto tok_index = tok_index_opt.value();
+            auto const &tiv = tokens_for(*parent_file);
+            auto s = get_token_string(*parent_file, tiv[tok_index]);
+            return s;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view ConvertAkToStd::token_view(FileId file, PackedToken const& token) {
+    // Only comments span lines, none of the tokens this is used for.
+    std::string_view line = resident(file).content_as_lines[token.start_line];
+    if (token.end_line != token.start_line)
+        return line.substr(token.start_column);
+    return line.substr(token.start_column, token.end_column - token.start_column + 1);
+}
+
+std::optional<std::string> ConvertAkToStd::expression_type(FileId file, size_t end, PackedTokens const& tiv, bool ask_engine, int depth) {
+    // Longer chains are not followed.
+    static constexpr int max_depth = 8;
+    if (depth > max_depth)
+        return std::nullopt;
+    auto text = [&](size_t index) { return token_view(file, tiv[index]); };
+
+    auto last = text(end);
+    if (last == ")" || last == "]") {
+        auto opening = last == ")" ? "(" : "[";
+        size_t open = end;
+        for (int nesting = 0;; --open) {
+            if (text(open) == last)
+                ++nesting;
+            else if (text(open) == opening && --nesting == 0)
+                break;
+            if (open == 0)
+                return std::nullopt;
+        }
+        if (open == 0)
+            return std::nullopt;
+        if (last == "]") {
+            auto container = expression_type(file, open - 1, tiv, true, depth + 1);
+            return container ? member_type(*container, "operator[]") : std::nullopt;
+        }
+        if (static_cast<TokenKind>(tiv[open - 1].type) != TokenKind::Identifier)
+            return std::nullopt;
+        return accessed_member_type(file, open - 1, tiv, depth);
+    }
+
+    if (static_cast<TokenKind>(tiv[end].type) != TokenKind::Identifier)
+        return std::nullopt;
+    if (auto type = accessed_member_type(file, end, tiv, depth))
+        return type;
+    bool is_accessed = end >= 1 && (text(end - 1) == "." || text(end - 1) == "->" || text(end - 1) == "::");
+    if (!ask_engine || is_accessed)
+        return std::nullopt;
+    // A local variable or a parameter, the engine only tells the name of its type.
+    auto type = declared_type_from_engine(file, tiv[end]);
+    if (!type)
+        return std::nullopt;
+    return std::string { *type };
+}
+
+std::optional<std::string> ConvertAkToStd::accessed_member_type(FileId file, size_t name, PackedTokens const& tiv, int depth) {
+    auto text = [&](size_t index) { return token_view(file, tiv[index]); };
+    auto member = text(name);
+    if (name >= 2 && (text(name - 1) == "." || text(name - 1) == "->")) {
+        bool is_arrow = text(name - 1) == "->";
+        if (is_arrow && text(name - 2) == "this") {
+            auto class_name = enclosing_class_name(file, name, tiv);
+            return class_name ? member_type(std::string { *class_name }, member) : std::nullopt;
+        }
+        auto owner = expression_type(file, name - 2, tiv, true, depth + 1);
+        if (owner && is_arrow)
+            owner = arrow_type(*owner);
+        return owner ? member_type(*owner, member) : std::nullopt;
+    }
+    if (name >= 1 && text(name - 1) == "::")
+        return std::nullopt;
+    // An unqualified name is looked up as a member of the enclosing class if
+    // it is named like one. Any other name can be a local or a parameter that
+    // shadows a member, which only the engine tells apart.
+    if (!m_symbol_database || !member.starts_with("m_"))
+        return std::nullopt;
+    auto class_name = enclosing_class_name(file, name, tiv);
+    return class_name ? member_type(std::string { *class_name }, member) : std::nullopt;
+}
+
+std::optional<std::string_view> ConvertAkToStd::enclosing_class_name(FileId file, size_t index, PackedTokens const& tiv) {
+    auto& state = m_files[file];
+    if (!state.class_scopes)
+        state.class_scopes = class_scopes(tiv, [&](size_t i) { return token_view(file, tiv[i]); });
+    return enclosing_class(*state.class_scopes, index);
+}
+
+std::optional<std::string> ConvertAkToStd::member_type(std::string const& owner, std::string_view member) const {
+    auto parsed = ParsedType::parse(owner);
+    if (auto type = AkTypeModel::instance().member_type(parsed, member))
+        return type;
+    if (m_symbol_database) {
+        if (auto found = m_symbol_database->find_member(parsed.name, member))
+            return std::string { found->type };
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> ConvertAkToStd::arrow_type(std::string const& type) const {
+    auto parsed = ParsedType::parse(type);
+    if (parsed.is_pointer)
+        return parsed.value_type();
+    // Smart pointers and Optional.
+    auto target = member_type(type, "operator->");
+    if (!target)
+        return std::nullopt;
+    return ParsedType::parse(*target).value_type();
+}
+
+bool ConvertAkToStd::token_is_left_paren(FileId file, int token_index, PackedTokens const &tiv) {
+    if (get_token_string(file, tiv[token_index]) == "(")
+        return true;
+    return false;
+}
+
+
+bool ConvertAkToStd::token_is_right_paren (FileId file, int token_index, PackedTokens const &tiv) {
+    if (get_token_string(file, tiv[token_index]) == ")")
+        return true;
+    return false;
+}
+
+std::optional<std::pmr::string> ConvertAkToStd::text_between_matching_parens(
+        FileId file
+        , int line
+        , int position
+        , PackedTokens const &tiv)
+{
+    auto tok_index_opt = find_token_index(line, position, tiv);
+    if (!tok_index_opt) return std::nullopt;
+
+    std::optional<std::pmr::string> result;
+    auto tok_index = tok_index_opt.value() + 1;
+
+    // Helper lambda to add current token to result string
+    auto extend_result = [this, &result, file, &tiv, &tok_index]() {
+        if (result.has_value()) {
+            result.value().append(get_whitespace_between_tokens(file, tok_index - 1, tok_index, tiv));
+            result.value().append(get_token_string(file, tiv[tok_index]));
+        } else {
+            result = get_token_string(file, tiv[tok_index]);
+        }
+    };
+
+    // The anchor can be the last token of the file or of a streaming window.
+    int paren_depth = 0;
+    while (tok_index < tiv.size()) {
+        if (token_is_left_paren(file, tok_index, tiv)) {
+            if (paren_depth > 0) extend_result();
+            paren_depth++;
+        } else if (token_is_right_paren(file, tok_index, tiv)) {
+            paren_depth--;
+            if (paren_depth > 0) extend_result();
+        } else
+            extend_result();
+
+        tok_index++;
+        if (!paren_depth)
+            break;
+    }
+
+    // The tokens ended before the parens were balanced, e.g. at the end of a streaming window.
+    if (paren_depth)
+        return std::nullopt;
+    return result;
+}
+
+std::pmr::string ConvertAkToStd::get_whitespace_between_tokens(FileId file, int prev_token, int token, PackedTokens const &tiv) {
+    auto prev_token_info = tiv[prev_token];
+    auto token_info = tiv[token];
+    PackedToken info {};
+    info.start_line = prev_token_info.end_line;
+    info.start_column = prev_token_info.end_column + 1;
+    info.end_line = token_info.start_line;
+    info.end_column = (token_info.start_column == 0) ? 0 : token_info.start_column - 1;
+
+    return get_token_string(file, info);
+}
+
+std::optional<int> ConvertAkToStd::position_of_last_matching_paren(FileId file, int line, int position, PackedTokens const &tiv)
+{
+    auto tok_index_opt = find_token_index(line, position, tiv);
+    if (!tok_index_opt) return std::nullopt;
+
+    auto tok_index = tok_index_opt.value() + 1;
+    int paren_depth = 0;
+    while (tok_index < tiv.size()) {
+        if (token_is_left_paren(file, tok_index, tiv)) {
+            paren_depth++;
+        } else if (token_is_right_paren(file, tok_index, tiv)) {
+            paren_depth--;
+        }
+        tok_index++;
+        if (!paren_depth)
+            break;
+    }
+
+    if (!paren_depth && tok_index < tiv.size() && token_is_right_paren(file, tok_index - 1, tiv))
+        return tiv[tok_index].start_column;
+    return std::nullopt;
+}
+
+std::vector<std::string> ConvertAkToStd::convert(const char *filename) {
+    auto file = file_id(filename);
+    if (!file) {
+        dbgln("{} was not added", filename);
+        return {};
+    }
+
+    std::vector<std::string> result;
+    {
+        FileArena arena(*this, arena_size_for(*file));
+        auto converted = convert_lines(*file);
+
+        auto prologue = converted.prologue ? &*converted.prologue : nullptr;
+        result.reserve(converted.lines.size() + (prologue ? prologue->includes.size() + prologue->declarations.size() : 0));
+        PrologueSplicer splicer { prologue, [&](std::string_view line) { result.emplace_back(line); } };
+        for (auto const& line : converted.lines)
+            splicer.add(line);
+        splicer.finish();
+    }
+    enforce_memory_budget();
+    return result;
+}
+
+std::string ConvertAkToStd::convert_to_string(const char* filename) {
+    auto file = file_id(filename);
+    if (!file) {
+        dbgln("{} was not added", filename);
+        return {};
+    }
+
+    std::string result;
+    {
+        FileArena arena(*this, arena_size_for(*file));
+        auto converted = convert_lines(*file);
+
+        auto prologue = converted.prologue ? &*converted.prologue : nullptr;
+        size_t size = 0;
+        for (auto const& line : converted.lines)
+            size += line.size() + 1;
+        if (prologue) {
+            for (auto const& line : prologue->includes)
+                size += line.size() + 1;
+            for (auto const& line : prologue->declarations)
+                size += line.size() + 1;
+        }
+
+        result.reserve(size);
+        PrologueSplicer splicer { prologue, [&](std::string_view line) {
+            result += line;
+            result += '\n';
+        } };
+        for (auto const& line : converted.lines)
+            splicer.add(line);
+        splicer.finish();
+    }
+    enforce_memory_budget();
+    return result;
+}
+
+size_t ConvertAkToStd::arena_size_for(FileId file) {
+    // Rewritten lines, the output vector and the token strings together stay
+    // within a few times the size of the source for typical files.
+    static constexpr size_t minimum_arena_size = 64 * 1024;
+    return std::max(minimum_arena_size, resident(file).content_as_string.size() * 4);
+}
+
+ConvertAkToStd::ConvertedLines ConvertAkToStd::convert_lines(FileId file) {
+    std::pmr::vector<std::pmr::string> converted { m_arena };
+    // The engine (created on the first declaration lookup) and the token
+    // vectors outlive a single conversion so that converting several files (or
+    // the same file again in watch mode) only parses what changed since the
+    // last call.
+    ConversionStats::FileScope file_scope(m_stats, m_files[file].name);
+    ConversionStats::Scope scope(m_stats, Phase::Rewriting);
+    TRACE_SPAN("rewrite", "convert", m_files[file].name);
+    ConversionState state { m_arena };
+    static PackedTokens const no_tokens;
+    bool textual_only = !needs_tokens(file);
+    auto const& tokens = textual_only ? no_tokens : tokens_for(file);
+    auto const& lines = m_files[file].content_as_lines;
+    if (m_stats) {
+        m_stats->files++;
+        m_stats->textual_files += textual_only;
+        m_stats->lines += lines.size();
+        m_stats->bytes += m_files[file].content_as_string.size();
+    }
+    m_rules->prefilter().flag_lines(m_files[file].content_as_string, m_line_flags);
+    for (size_t row = 0; row < lines.size(); ++row) {
+        state.line_num++;
+        if (!m_line_flags[row]) {
+            track_output_line(state, lines[row], converted.size());
+            converted.emplace_back(lines[row]);
+            continue;
+        }
+        std::pmr::string line { lines[row], m_arena };
+        bool keep = m_line_cache ? convert_line_cached(file, tokens, row, line, state) : convert_line(file, tokens, row, line, state);
+        if (keep) {
+            track_output_line(state, line, converted.size());
+            converted.push_back(std::move(line));
+        }
+    }
+    record_footprint();
+
+    auto prologue = plan_prologue(state);
+    return { std::move(converted), std::move(prologue) };
+}
+
+FileId ConvertAkToStd::streaming_window_file() {
+    if (m_streaming_window_file)
+        return *m_streaming_window_file;
+
+    auto file = static_cast<FileId>(m_files.size());
+    auto& state = m_files.emplace_back();
+    state.name = "<stream>";
+    state.has_semantics = false;
+    state.has_tokens = true;
+    state.is_pinned = true;
+    m_streaming_window_file = file;
+    return file;
+}
+
+template<typename Callback>
+void ConvertAkToStd::for_each_streamed_line(std::istream& input, size_t window_lines, ConversionState& state, Callback on_converted_line) {
+    // Lines of the previous window that are lexed again, so that rules at the
+    // start of a window can still look at the tokens in front of them.
+    static constexpr size_t overlap_lines = 4;
+
+    auto file = streaming_window_file();
+    auto& window = m_files[file];
+    auto& lines = window.content_as_lines;
+    lines.clear();
+    ConversionStats::FileScope file_scope(m_stats, window.name);
+
+    std::vector<LexState> line_start_states;
+    LexState window_start_state = LexState::Code;
+    size_t overlap = 0;
+    bool input_done = false;
+    std::string line;
+    auto read_line = [&] {
+        ConversionStats::Scope scope(m_stats, Phase::Load);
+        if (input_done || !std::getline(input, line)) {
+            input_done = true;
+            return false;
+        }
+        lines.push_back(std::move(line));
+        if (m_stats) {
+            m_stats->lines++;
+            m_stats->bytes += lines.back().size() + 1;
+        }
+        return true;
+    };
+
+    while (true) {
+        {
+            TRACE_SPAN("load", "read window");
+            while (lines.size() - overlap < window_lines && read_line()) { }
+        }
+        size_t convert_end = lines.size();
+        if (convert_end == overlap)
+            break;
+
+        window.tokens.clear();
+        line_start_states.clear();
+        LexState lex_state = window_start_state;
+        int paren_depth = 0;
+        auto lex = [&](size_t row) {
+            ConversionStats::Scope scope(m_stats, Phase::Tokenization);
+            line_start_states.push_back(lex_state);
+            auto first_new_token = window.tokens.size();
+            lex_line(lines[row], row, lex_state, window.tokens);
+            if (row < overlap)
+                return;
+            for (auto i = first_new_token; i < window.tokens.size(); ++i) {
+                auto const& token = window.tokens[i];
+                if (token.type != static_cast<uint32_t>(TokenKind::Punctuation))
+                    continue;
+                if (lines[row][token.start_column] == '(')
+                    paren_depth++;
+                else if (lines[row][token.start_column] == ')')
+                    paren_depth = std::max(0, paren_depth - 1);
+            }
+        };
+        {
+            TRACE_SPAN("lex", "lex window");
+            for (size_t row = 0; row < lines.size(); ++row)
+                lex(row);
+        }
+        // Look ahead until the parens opened in this window are closed again. The
+        // lookahead lines are converted as part of the next window.
+        for (size_t lookahead = 0; paren_depth > 0 && lookahead < window_lines && read_line(); ++lookahead)
+            lex(lines.size() - 1);
+        update_resident_bytes(window);
+        record_footprint();
+
+        size_t window_bytes = 0;
+        for (auto const& window_line : lines)
+            window_bytes += window_line.size() + 1;
+        {
+            FileArena arena(*this, window_bytes * 4);
+            ConversionStats::Scope scope(m_stats, Phase::Rewriting);
+            TRACE_SPAN("rewrite", "convert window");
+            for (size_t row = overlap; row < convert_end; ++row) {
+                std::pmr::string converted_line { lines[row], m_arena };
+                state.line_num++;
+                if (convert_line(file, window.tokens, row, converted_line, state))
+                    on_converted_line(converted_line);
+            }
+        }
+
+        size_t keep_from = convert_end > overlap_lines ? convert_end - overlap_lines : 0;
+        window_start_state = line_start_states[keep_from];
+        lines.erase(lines.begin(), lines.begin() + keep_from);
+        overlap = convert_end - keep_from;
+    }
+
+    lines.clear();
+    window.tokens.clear();
+    update_resident_bytes(window);
+}
+
+void ConvertAkToStd::convert_stream(std::istream& input, std::ostream& output, size_t window_lines) {
+    window_lines = std::max<size_t>(window_lines, 1);
+    auto start = input.tellg();
+
+    // First pass: only collect what plan_prologue() needs. Its rule counters
+    // would repeat the ones of the second pass, only its time is kept.
+    ConversionStats first_pass_stats;
+    auto* stats = std::exchange(m_stats, m_stats ? &first_pass_stats : nullptr);
+    ConversionState state { std::pmr::get_default_resource() };
+    int converted_lines = 0;
+    for_each_streamed_line(input, window_lines, state, [&](std::pmr::string const& line) {
+        track_output_line(state, line, converted_lines++);
+    });
+    auto prologue = plan_prologue(state);
+    m_stats = stats;
+    if (m_stats) {
+        m_stats->merge_phase_times(first_pass_stats);
+        m_stats->files++;
+    }
+
+    input.clear();
+    input.seekg(start);
+
+    // Second pass: write the converted lines with the prologue spliced in.
+    ConversionState second_pass_state { std::pmr::get_default_resource() };
+    PrologueSplicer splicer { prologue ? &*prologue : nullptr, [&](std::string_view line) {
+        ConversionStats::Scope scope(m_stats, Phase::Output);
+        output << line << '\n';
+    } };
+    for_each_streamed_line(input, window_lines, second_pass_state, [&](std::pmr::string const& line) {
+        splicer.add(line);
+    });
+    splicer.finish();
+}
+
+void ConvertAkToStd::require_header(ConversionState& state, std::string_view header) {
+    if (header.empty())
+        return;
+    if (header == "<vector>")
+        state.include_vector = true;
+    else if (header == "<cassert>")
+        state.include_cassert = true;
+    else if (header == "\"intrusive_ptr.hh\"")
+        state.include_intrusive_ptr = true;
+    else if (header == "\"util.hh\"")
+        state.include_util = true;
+    else if (header == "<optional>")
+        state.include_optional = true;
+    else if (header == "<string_view>")
+        state.include_string_view = true;
+    else if (header == "<string>")
+        state.include_string = true;
+    else
+        state.extra_includes.emplace(header);
+}
+
+void ConvertAkToStd::rewrite_identifiers(std::pmr::string& line, ConversionState& state, RuleSet::IdentifierPass pass) {
+    auto is_identifier_char = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    std::pmr::string result { m_arena };
+    // A rule fires once per line, however often its identifier occurs.
+    struct MatchedRule {
+        RuleSet::IdentifierRule const* rule;
+        RuleMark mark;
+    };
+    std::array<MatchedRule, 8> matched_on_line {};
+    size_t matched_rules = 0;
+    size_t copied_until = 0;
+    size_t position = 0;
+    while (position < line.size()) {
+        if (!is_identifier_char(line[position])) {
+            ++position;
+            continue;
+        }
+        auto start = position;
+        while (position < line.size() && is_identifier_char(line[position]))
+            ++position;
+        std::string_view identifier { line.data() + start, position - start };
+        auto const* rule = m_rules->find_identifier(identifier);
+        if (!rule) {
+            if (pass == RuleSet::IdentifierPass::Types && m_rules->is_debug_constant(identifier)) {
+                begin_rule(identifier);
+                state.debug_constants.emplace(identifier);
+            }
+            continue;
+        }
+        if (rule->pass != pass)
+            continue;
+
+        auto matched = std::span { matched_on_line }.first(matched_rules);
+        if (auto seen = std::ranges::find(matched, rule, &MatchedRule::rule); seen != matched.end()) {
+            m_current_rule = seen->mark;
+        } else {
+            begin_rule(rule->identifier);
+            if (matched_rules < matched_on_line.size())
+                matched_on_line[matched_rules++] = { rule, m_current_rule };
+        }
+        if (rule->is_debug_constant) {
+            state.debug_constants.emplace(rule->identifier);
+            continue;
+        }
+        count_rewrite();
+        require_header(state, rule->header);
+        result.append(line, copied_until, start - copied_until);
+        result.append(rule->replacement);
+        copied_until = position;
+    }
+    if (copied_until == 0)
+        return;
+    result.append(line, copied_until);
+    line = std::move(result);
+}
+
+void ConvertAkToStd::rewrite_literals(std::pmr::string& line, ConversionState& state) {
+    std::pmr::string result { m_arena };
+    size_t copied_until = 0;
+    m_rules->for_each_literal(line, [&](size_t position, RuleSet::LiteralRule const& rule) {
+        begin_rule(rule.text);
+        count_rewrite();
+        require_header(state, rule.header);
+        result.append(line, copied_until, position - copied_until);
+        result.append(rule.replacement);
+        copied_until = position + rule.text.size();
+    });
+    if (copied_until == 0)
+        return;
+    result.append(line, copied_until);
+    line = std::move(result);
+}
+
+bool ConvertAkToStd::needs_conversion(std::string_view content) const {
+    thread_local std::vector<uint8_t> line_flags;
+    m_rules->prefilter().flag_lines(content, line_flags);
+    return std::find(line_flags.begin(), line_flags.end(), 1) != line_flags.end();
+}
+
+bool ConvertAkToStd::convert_line_cached(FileId file, PackedTokens const& tokens, int row, std::pmr::string& line, ConversionState& state) {
+    // The parts of a ConversionState that convert_line() sets, as the flags of a cache entry.
+    static constexpr std::array cached_state_flags {
+        &ConversionState::include_vector,
+        &ConversionState::include_cassert,
+        &ConversionState::include_intrusive_ptr,
+        &ConversionState::include_util,
+        &ConversionState::include_optional,
+        &ConversionState::include_string_view,
+        &ConversionState::include_string,
+        &ConversionState::add_todo_entry,
+        &ConversionState::uses_string_view_literals,
+    };
+    auto lookup = m_line_cache->find(line);
+    if (lookup.entry ? lookup.entry->depends_on_tokens : !lookup.worth_caching)
+        return convert_line(file, tokens, row, line, state);
+    if (auto const* entry = lookup.entry) {
+        for (size_t i = 0; i < cached_state_flags.size(); ++i) {
+            if (entry->flags & (1u << i))
+                state.*cached_state_flags[i] = true;
+        }
+        if (entry->is_include && !state.first_include)
+            state.first_include = state.line_num - 1;
+        state.debug_constants.insert(entry->debug_constants.begin(), entry->debug_constants.end());
+        state.extra_includes.insert(entry->extra_includes.begin(), entry->extra_includes.end());
+        if (m_stats) {
+            m_stats->cached_lines++;
+            for (auto const& hit : entry->rule_hits) {
+                auto& counters = m_stats->rule(hit.name);
+                counters.fired++;
+                counters.replacements += hit.replacements;
+            }
+        }
+        if (!entry->line)
+            return false;
+        line.assign(*entry->line);
+        return true;
+    }
+
+    // The line is converted on a state of its own, which tells what it adds.
+    LineCache::Entry entry;
+    std::pmr::string original { line, m_arena };
+    ConversionState line_state { m_arena };
+    line_state.line_num = state.line_num;
+    m_line_uses_tokens = false;
+    m_recorded_rules = m_stats ? &entry.rule_hits : nullptr;
+    bool keep = convert_line(file, tokens, row, line, line_state);
+    m_recorded_rules = nullptr;
+
+    for (size_t i = 0; i < cached_state_flags.size(); ++i) {
+        if (line_state.*cached_state_flags[i]) {
+            state.*cached_state_flags[i] = true;
+            entry.flags |= 1u << i;
+        }
+    }
+    if (line_state.first_include) {
+        entry.is_include = true;
+        if (!state.first_include)
+            state.first_include = line_state.first_include;
+    }
+    for (auto const& constant : line_state.debug_constants) {
+        state.debug_constants.insert(constant);
+        entry.debug_constants.emplace_back(constant);
+    }
+    for (auto const& header : line_state.extra_includes) {
+        state.extra_includes.insert(header);
+        entry.extra_includes.emplace_back(header);
+    }
+    if (m_line_uses_tokens) {
+        m_line_cache->insert(original, { .depends_on_tokens = true });
+    } else {
+        if (keep)
+            entry.line.emplace(line);
+        m_line_cache->insert(original, std::move(entry));
+    }
+    return keep;
+}
+
+bool ConvertAkToStd::convert_line(FileId file, PackedTokens const& tokens, int row, std::pmr::string& line, ConversionState& state) {
+    using CodeRule = RuleSet::CodeRule;
+    m_current_rule = {};
+    if (line.starts_with("#include ")) {
+        if (auto rewrite = include_rewriter().rewrite(std::string_view { line }.substr(strlen("#include ")))) {
+            if (!state.first_include) state.first_include = state.line_num - 1;
+            begin_rule(rewrite->rule);
+            if (rewrite->is_unterminated) {
+                dbgln("Couldn't find the closing delimiter in #include line");
+                return false;
+            }
+            count_rewrite();
+            if (!rewrite->line)
+                return false;
+            line.assign(*rewrite->line);
+            return true;
+        }
+    }
+
+    if (contains(line, RuleSet::code_rule(CodeRule::StringViewLiteral).anchor))
+        state.uses_string_view_literals = true;
+    rewrite_literals(line, state);
+    rewrite_identifiers(line, state, RuleSet::IdentifierPass::Types);
+    if (rule_matches(line, CodeRule::ByteStringEmpty)) {
+        rewrite(line, "ByteString::empty()", "\"\"");
+    }
+    if (rule_matches(line, CodeRule::ByteStringJoin)) {
+        rewrite(line, "ByteString::join", "join_strings");
+        state.include_string = true;
+    }
+    if (rule_matches(line, CodeRule::StringBuilderDeclaration)) {
+        rewrite(line, "StringBuilder ", "std::string ");
+        state.include_string = true;
+    }
+    if (rule_matches(line, CodeRule::StringCall)) {
+        rewrite(line, "String( )", "std::string(");
+        state.include_string = true;
+    }
+    if (rule_matches(line, CodeRule::Verify)) {
+        rewrite(line, "VERIFY(", "assert(");
+        state.include_cassert = true;
+    }
+    if (rule_matches(line, CodeRule::Move)) {
+        rewrite(line, " move(", " std::move(");
+    }
+    if (rule_matches(line, CodeRule::ParenthesizedMove)) {
+        rewrite(line, "(move(", "(std::move(");
+    }
+    if (rule_matches(line, CodeRule::Append)) {
+        auto position = line.find("append(");
+        auto parent_token_type = find_parent_token_type(file, row, position,
+                                                        tokens);
+        if (parent_token_type.has_value() && parent_token_type.value() == "StringBuilder") {
+            // StringBuilders are converted to std::string which have an append function!
+            // But this function does not work with chars and push_back needs to be used...
+            auto text_between = text_between_matching_parens(file, row, position, tokens);
+            if (text_between) {
+                if (text_between.value().at(0) == '\'')
+                    rewrite(line, "append(", "push_back(");
+            }
+        } else
+            rewrite(line, "append(", "push_back(");
+    }
+    if (rule_matches(line, CodeRule::Ptr)) {
+        rewrite(line, "ptr()", "get()");
+    }
+
+    if (rule_matches(line, CodeRule::ToByteString)) {
+        auto position = line.find("to_byte_string");
+        auto parent_token_type = find_parent_token_type(file, row, position,
+                                                        tokens);
+        if (parent_token_type.has_value() && parent_token_type.value() ==
+                                             "StringBuilder") { // StringBuilders are converted to std::string and no to_string is needed
+            rewrite(line, ".to_byte_string()", "");
+            rewrite(line, "->to_byte_string()", "");
+        } else
+            rewrite(line, "to_byte_string()", "to_string()");
+    }
+    if (rule_matches(line, CodeRule::IsEmpty)) {
+        rewrite(line, "is_empty()", "empty()");
+    }
+    if (rule_matches(line, CodeRule::VerifyCast)) {
+        rewrite(line, "verify_cast", "assert_cast");
+        state.include_util = true;
+    }
+    if (rule_matches(line, CodeRule::ScopeLogger)) {
+        state.include_util = true;
+    }
+    if (rule_matches(line, CodeRule::Extend)) {
+        auto position = line.find("extend");
+        auto object = object_text(file, row, position, tokens);
+        if (object.has_value()) {
+            auto text_between = text_between_matching_parens(file, row, position, tokens);
+
+            if (text_between.has_value()) {
+                // Construct a reasonable temporary variable name
+                std::pmr::string temp_variable_name { text_between.value(), m_arena };
+                replace(temp_variable_name, "m_", "");
+                replace(temp_variable_name, ".", "_");
+                replace(temp_variable_name, "->", "_");
+                replace(temp_variable_name, "(", "");
+                replace(temp_variable_name, ")", "");
+
+                std::pmr::string only_whitespace { m_arena };
+                std::copy_if(
+                        line.begin(),
+                        line.end(),
+                        std::back_inserter(only_whitespace),
+                        [](auto c) { return std::isspace(c); }
+                );
+
+                auto format_parameters = format("{}.begin(), {}.end()", temp_variable_name,
+                                                temp_variable_name
+                );
+                rewrite(line, text_between.value(), format_parameters);
+                rewrite(line, "extend(", format("insert({}.end(), ", object.value()));
+                count_rewrite();
+                line = format("{}{{\nauto {}    {} = {};\n    {}\n{}}}", only_whitespace, only_whitespace,
+                                   temp_variable_name, text_between.value(), line, only_whitespace);
+            }
+        }
+
+    }
+    if (rule_matches(line, CodeRule::Appendff)) {
+        auto position = line.find("appendff");
+        auto last_matching_paren = position_of_last_matching_paren(file, row, position,
+                                                                   tokens);
+        // The column is one of the source line, earlier rewrites may have shortened the line.
+        if (last_matching_paren && static_cast<size_t>(last_matching_paren.value()) <= line.size()) {
+            line.insert(line.begin() + last_matching_paren.value(), ')');
+            count_rewrite();
+            rewrite(line, "appendff", "append(fmt::format");
+        }
+    }
+    if (rule_matches(line, CodeRule::Empend)) {
+        rewrite(line, "empend", "emplace_back");
+    }
+    if (rule_matches(line, CodeRule::ByteStringFormatted)) {
+        rewrite(line, "ByteString::formatted", "fmt::format");
+        state.include_string = true;
+    }
+    rewrite_identifiers(line, state, RuleSet::IdentifierPass::ByteString);
+
+    if (rule_matches(line, CodeRule::TypeAsByteString)) {
+        rewrite(line, "type_as_byte_string", "type_as_string");
+    }
+
+    if (rule_matches(line, CodeRule::StringDeclaration)) {
+        auto position = line.find("String ");
+        auto tok_index = find_token_index(row, position, tokens);
+        if (tok_index) {
+            if (token_string(file, tok_index.value(), tokens) == "String") {
+                rewrite(line, "String ", "std::string ");
+                state.include_string = true;
+            }
+        }
+    }
+
+    if (rule_matches(line, CodeRule::MakeNoncopyable)) {
+        auto position = line.find("AK_MAKE_NONCOPYABLE");
+        auto class_name = text_between_matching_parens(file, row, position, tokens);
+        if (class_name) {
+            std::pmr::string whitespace { m_arena };
+            std::copy_if(
+                    line.begin(),
+                    line.end(),
+                    std::back_inserter(whitespace),
+                    [](auto c) { return std::isspace(c); }
+            );
+            line = format("{}{}({} const&) = delete;", whitespace, class_name.value(), class_name.value());
+            count_rewrite();
+        }
+    }
+
+    if (auto const& types_include = RuleSet::code_rule(CodeRule::CodeComprehensionTypesInclude); line == types_include.anchor) {
+        begin_rule(types_include.anchor);
+        count_rewrite();
+        state.add_todo_entry = true;
+        return false;
+    }
+
+    if (rule_matches(line, CodeRule::AdoptRef)) {
+        auto position = line.find("adopt_ref");
+        auto new_statement_text_opt = text_between_matching_parens(file, row, position,
+                                                                   tokens);
+        if (new_statement_text_opt) {
+            std::pmr::string new_statement_text { new_statement_text_opt.value(), m_arena };
+            auto full_text = format("adopt_ref({})", new_statement_text);
+            new_statement_text.erase(0, 1); // Remove the '*' character in adopt_ref(* <--
+            rewrite(line, full_text, new_statement_text);
+        }
+    }
+
+    if (rule_matches(line, CodeRule::Forward)) {
+        rewrite(line, " forward<", " std::forward<");
+    }
+
+    if (rule_matches(line, CodeRule::First) && m_files[file].has_semantics) {
+        // Each call is decided on its own receiver. Earlier rules may have
+        // moved the calls in `line`, their columns come from the source line.
+        constexpr std::string_view call = "first()";
+        std::string_view source = m_files[file].content_as_lines[row];
+        auto is_identifier_char = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+        size_t source_position = source.find(call);
+        size_t position = line.find(call);
+        for (; source_position != std::string_view::npos && position != std::pmr::string::npos;
+             source_position = source.find(call, source_position + call.size()), position = line.find(call, position + call.size())) {
+            // Not e.g. take_first().
+            if (source_position > 0 && is_identifier_char(source[source_position - 1]))
+                continue;
+            auto parent_token_type = find_parent_token_type(file, row, source_position, tokens);
+            if (parent_token_type.has_value() && parent_token_type.value() == "Vector") {
+                line.replace(position, call.size(), "front()");
+                count_rewrite();
+            }
+        }
+    }
+
+    return true;
+}
+
+void ConvertAkToStd::track_output_line(ConversionState& state, std::string_view line, int index) {
+    if (!line.starts_with('#'))
+        return;
+    if (!state.pragma_once_index && line == "#pragma once")
+        state.pragma_once_index = index;
+    if (line.starts_with("#include")) {
+        state.last_include = index;
+        auto argument = line.substr(strlen("#include"));
+        argument.remove_prefix(std::min(argument.find_first_not_of(" \t"), argument.size()));
+        if (argument.empty())
+            return;
+        auto end = argument.find(argument[0] == '<' ? '>' : '"', 1);
+        if (end != std::string_view::npos)
+            state.present_includes.emplace(argument.substr(0, end + 1));
+    }
+}
+
+std::optional<ConvertAkToStd::Prologue> ConvertAkToStd::plan_prologue(ConversionState const& state) {
+    auto first_include = state.first_include;
+    if (!first_include) {
+        dbgln("finding #pragma once");
+        if (!state.pragma_once_index) {
+            dbgln("no pragma once");
+            return std::nullopt;
+        }
+
+        first_include = state.pragma_once_index;
+    }
+
+    Prologue prologue { m_arena };
+    prologue.includes_position = first_include.value();
+    prologue.declarations_position = state.last_include + 1;
+
+    // If we are using string view literals we need a using namespace directive
+    if (state.uses_string_view_literals) {
+        dbgln("Last include: {}", state.last_include);
+        prologue.declarations.emplace_back("\nusing namespace std::literals;");
+    }
+
+    // Add any used debug constants
+    for (auto it = state.debug_constants.rbegin(); it != state.debug_constants.rend(); ++it)
+        prologue.declarations.push_back(format("constexpr bool {} = false;", *it));
+
+    const char *todo_entry = "          \n"
+                             "namespace CodeComprehension {      \n"
+                             "    struct TodoEntry {             \n"
+                             "        std::string content;       \n"
+                             "        std::string filename;      \n"
+                             "        size_t line { 0 };         \n"
+                             "        size_t column { 0 };       \n"
+                             "    };                             \n"
+                             "}                                  \n";
+    if (state.add_todo_entry)
+        prologue.declarations.emplace_back(todo_entry);
+
+    auto include = [&](std::string_view header) {
+        if (!state.present_includes.contains(header))
+            prologue.includes.push_back(format("#include {}", header));
+    };
+    if (state.include_cassert)
+        include("<cassert>");
+    if (state.include_optional)
+        include("<optional>");
+    if (state.include_string_view)
+        include("<string_view>");
+    if (state.include_string)
+        include("<string>");
+    if (state.include_vector)
+        include("<vector>");
+    if (state.include_util)
+        include(format("\"{}util.hh\"", m_include_path));
+    if (state.include_intrusive_ptr)
+        include(format("\"{}intrusive_ptr.hh\"", m_include_path));
+    for (auto const& header : state.extra_includes)
+        include(header);
+
+    return prologue;
+}
@@ -0,0 +1,437 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fmt/format.h>
+#include <cpp/cppcomprehensionengine.hh>
+#include "ak_type_model.h"
+#include "conversion_stats.h"
+#include "engine_queries.h"
+#include "include_rewriter.h"
+#include "line_cache.h"
+#include "local_filedb.h"
+#include "packed_token.h"
+#include "rule_set.h"
+#include "symbol_database.h"
+
+// Dense index of a file added to a ConvertAkToStd, assigned by add_file().
+using FileId = uint32_t;
+
+bool contains(std::string_view str, std::string_view text);
+
+// Returns the number of replacements.
+template<typename String>
+std::size_t replace(String& str, std::string_view text_to_replace, std::string_view replacement) {
+    // A replacement that contains the text again (e.g. "from" -> "from.begin(), from.end()")
+    // must not be matched again, or this would never stop.
+    bool replacement_contains_text = replacement.find(text_to_replace) != std::string_view::npos;
+    std::size_t replacements = 0;
+    std::size_t pos = str.find(text_to_replace);
+    while(pos != String::npos) {
+        str.replace(pos, text_to_replace.size(), replacement);
+        replacements++;
+
+        //Check if there is more text to replace
+        pos = str.find(text_to_replace, replacement_contains_text ? pos + replacement.size() : 0);
+    }
+    return replacements;
+}
+
+template<typename String>
+String to_lower_case(String input) {
+    std::transform (input.begin (), input.end (), input.begin (), [] (unsigned char c) { return std::tolower (c); });
+    return input;
+}
+std::optional<PackedTokens::size_type> find_token_index(int row, int column, PackedTokens const& tokens);
+std::string to_string(PackedToken const& token_info);
+
+// Splits a buffer into lines the same way std::getline would.
+std::vector<std::string> split_into_lines(std::string_view content);
+
+// Converts AK based sources to the standard library. All input comes from
+// in-memory buffers registered with add_file(), the converter does no file I/O
+// and keeps no state outside of the object, so several converters can be used
+// side by side (and from different threads).
+class ConvertAkToStd {
+protected:
+    struct FileState {
+        std::string name;
+        std::string content_as_string;
+        std::vector<std::string> content_as_lines;
+        PackedTokens tokens;
+        bool has_tokens { false };
+        // Of the tokens, computed on the first lookup that needs them.
+        std::optional<std::vector<ClassScope>> class_scopes;
+        // Whether any rule that looks at tokens can fire, see needs_tokens().
+        std::optional<bool> needs_tokens;
+        // False for the window of a streamed file, which the engine never sees.
+        bool has_semantics { true };
+
+        // Memory budget bookkeeping, see set_memory_budget().
+        bool is_resident { true };
+        bool is_pinned { false };
+        bool parsed_by_engine { false };
+        // Position in m_lru_files while the file is resident.
+        std::optional<std::list<FileId>::iterator> lru_position;
+        size_t resident_bytes { 0 };
+        size_t token_bytes { 0 };
+    };
+
+    std::string m_include_path;
+    LocalFileDB filedb;
+    // Per-file data is indexed by FileId, names are only looked up when a file
+    // is added and when the engine reports a location in another file.
+    std::vector<FileState> m_files;
+    std::unordered_map<std::string, FileId> m_file_ids;
+    std::optional<FileId> m_streaming_window_file;
+    std::unique_ptr<CodeComprehension::Cpp::CppComprehensionEngine> engine;
+
+    LocalFileDB::Loader m_file_loader;
+    size_t m_memory_budget { 0 };
+    size_t m_resident_bytes { 0 };
+    // The part of m_resident_bytes that is packed tokens.
+    size_t m_token_bytes { 0 };
+    size_t m_engine_bytes { 0 };
+    // Every file the engine has read since it was created, e.g. the headers
+    // its parse of a queried file included. remove_file() drops the engine if
+    // it read the removed file.
+    std::unordered_set<std::string> m_engine_files;
+    // Resident files, least recently used first.
+    std::list<FileId> m_lru_files;
+
+    // Every temporary string of a conversion is allocated from m_arena. While a
+    // file is converted it points at that file's monotonic arena, whose first
+    // block (m_arena_buffer) is reused by the next file.
+    std::pmr::memory_resource* m_arena { std::pmr::get_default_resource() };
+    std::vector<std::byte> m_arena_buffer;
+    // Which lines of the file being converted can match a rule, see LinePrefilter.
+    std::vector<uint8_t> m_line_flags;
+
+    RuleSet const* m_rules { &RuleSet::built_in() };
+    // Shared with other converters if set, otherwise m_own_include_rewriter.
+    IncludeRewriter* m_include_rewriter { nullptr };
+    std::unique_ptr<IncludeRewriter> m_own_include_rewriter;
+
+    EngineQueryRecorder* m_query_recorder { nullptr };
+    uint32_t m_query_stream { 0 };
+
+    ConversionStats* m_stats { nullptr };
+    // The rule convert_line() is applying, see begin_rule().
+    struct RuleMark {
+        // Null without stats.
+        RuleCounters* counters { nullptr };
+        // Index into m_recorded_rules.
+        size_t hit { 0 };
+    };
+    RuleMark m_current_rule;
+
+    SymbolDatabase const* m_symbol_database { nullptr };
+
+    LineCache* m_line_cache { nullptr };
+    // While a line is converted for the line cache: the rules it fires, and
+    // whether one of them looked at tokens.
+    std::vector<LineCache::RuleHit>* m_recorded_rules { nullptr };
+    bool m_line_uses_tokens { false };
+
+    class FileArena {
+    public:
+        FileArena(ConvertAkToStd& converter, size_t expected_size);
+        ~FileArena();
+
+    private:
+        ConvertAkToStd& m_converter;
+        std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+    };
+
+public:
+    void add_include_filepath_for_output(std::string include_path);
+
+    // Adds a file to the conversion context, or replaces its content if it was
+    // added before. Only the replaced file's parsed state is dropped.
+    void add_file(std::string const& file_path, std::string_view content);
+    bool has_file(std::string const& file_path) const;
+    // Forgets a file that was deleted. Files that included it keep their
+    // state, but their declaration lookups no longer see it.
+    void remove_file(std::string const& file_path);
+
+    // Quoted includes of an added file, resolved against the including file's
+    // directory first and the root of the added files second.
+    std::set<std::string> included_files(std::string const& file_path);
+
+    // Every added file whose conversion can see declarations from `file_path`,
+    // i.e. everything that includes it directly or transitively.
+    std::set<std::string> files_depending_on(std::string const& file_path);
+
+    // Lets the converter evict the content, lines and tokens of files that are
+    // not pinned, least recently used first, whenever its estimated footprint
+    // exceeds `bytes` (0 means no limit). If that is not enough the engine and
+    // its parse trees are dropped as a whole. Evicted files are reloaded through
+    // the file loader on demand, without a loader nothing is evicted.
+    void set_memory_budget(size_t bytes);
+    void set_file_loader(LocalFileDB::Loader loader);
+    // Pinned files are never evicted. Replaces the previously pinned set.
+    void set_pinned_files(std::vector<std::string> const& file_paths);
+    size_t estimated_memory_usage() const { return m_resident_bytes + m_engine_bytes; }
+    // The engine's part is only measured when built with allocation counting,
+    // otherwise it is estimated from the parsed source size.
+    MemoryFootprint memory_footprint() const { return { m_resident_bytes - m_token_bytes, m_token_bytes, m_engine_bytes }; }
+
+    // Collects phase times and rule counters into `stats` (null to stop).
+    void set_stats(ConversionStats* stats);
+    // Records every engine query into `recorder` (null to stop), see
+    // EngineQueryRecorder. Call it before the first conversion.
+    void set_query_recorder(EngineQueryRecorder* recorder);
+
+    // Converts with `rules` (the built-in rules if null), which have to
+    // outlive the converter. Call it before the first conversion.
+    void set_rules(RuleSet const* rules);
+    // Rewrites #include lines with `rewriter`, so that converters which share
+    // it also share the converted include lines. It must be built from the
+    // same rules and include path. Null makes the converter use its own.
+    void set_include_rewriter(IncludeRewriter* rewriter);
+    // Takes the conversion of lines that depend on their text alone from
+    // `cache`, and adds the ones it converts (null to stop). Converters that
+    // share a cache must use the same rules and include path.
+    void set_line_cache(LineCache* cache);
+    // Looks up the types of receivers that are members of the enclosing class
+    // (`m_name` or `this->name`), and of the members they lead to, in
+    // `database` before asking the engine (null to stop). It has to outlive
+    // the converter.
+    void set_symbol_database(SymbolDatabase const* database);
+
+    // Whether convert() could change anything in `content`. A file without any
+    // rule anchor converts to its own lines.
+    bool needs_conversion(std::string_view content) const;
+
+    std::vector<std::string> convert(const char* filename);
+    // Same as convert(), with the lines joined into one newline terminated buffer.
+    std::string convert_to_string(const char* filename);
+
+    // Converts a file that is too large to be held in memory, `window_lines`
+    // lines at a time, writing the output as it goes. Tokens are only kept for
+    // the active window (plus the lines needed to finish a parenthesized
+    // expression that runs past its end), so the footprint stays at a small
+    // multiple of the window size. Declaration lookups are not available, rules
+    // that need them fall back to their textual rewrite. `input` is read twice
+    // and has to be seekable: the first pass finds out which includes and
+    // declarations the output needs in front of the converted code.
+    void convert_stream(std::istream& input, std::ostream& output, size_t window_lines = 4096);
+
+protected:
+    std::optional<FileId> file_id(std::string const& file_path) const;
+    FileState& resident(FileId file);
+    void update_resident_bytes(FileState& state);
+    // Makes `file` the most recently used one.
+    void mark_used(FileId file);
+    void evict(FileState& state);
+    void enforce_memory_budget();
+    // Drops the engine and all of its parse trees, the next lookup starts a new one.
+    void drop_engine();
+    size_t arena_size_for(FileId file);
+    CodeComprehension::Cpp::CppComprehensionEngine& ensure_engine();
+    // The read observer of filedb, which only the engine reads.
+    void on_engine_read(std::string const& path, std::string const& content);
+    // The engine, about to look at `file`.
+    CodeComprehension::Cpp::CppComprehensionEngine& engine_for(FileId file);
+    // Adds what the engine allocated and kept since `before` to m_engine_bytes,
+    // `returned_bytes` are the allocations it handed back to the caller.
+    void charge_engine_allocations(AllocationCounters const& before, size_t returned_bytes = 0);
+    void record_footprint();
+
+    // What the line rules found out about a whole file.
+    struct ConversionState {
+        explicit ConversionState(std::pmr::memory_resource* resource)
+            : debug_constants(resource)
+            , extra_includes(resource)
+            , present_includes(resource)
+        {
+        }
+
+        int line_num { 0 };
+        std::optional<int> first_include;
+        bool include_vector { false };
+        bool include_cassert { false };
+        bool include_intrusive_ptr { false };
+        bool include_util { false };
+        bool include_optional { false };
+        bool include_string_view { false };
+        bool include_string { false };
+        bool add_todo_entry { false };
+        bool uses_string_view_literals { false };
+        std::pmr::set<std::pmr::string> debug_constants;
+        // Headers of rule file rules that have no flag of their own.
+        std::pmr::set<std::pmr::string> extra_includes;
+
+        // What the converted lines already have, see track_output_line().
+        std::optional<int> pragma_once_index;
+        int last_include { 0 };
+        // Arguments of the #include lines, e.g. <vector>.
+        std::pmr::set<std::pmr::string, std::less<>> present_includes;
+    };
+
+    // Includes and declarations that go in front of the converted code.
+    // Positions are indices into the converted lines, see PrologueSplicer.
+    struct Prologue {
+        explicit Prologue(std::pmr::memory_resource* resource)
+            : includes(resource)
+            , declarations(resource)
+        {
+        }
+
+        int includes_position { 0 };
+        std::pmr::vector<std::pmr::string> includes;
+        int declarations_position { 0 };
+        std::pmr::vector<std::pmr::string> declarations;
+    };
+
+    // Passes the converted lines on with the prologue spliced in, as they are
+    // produced: the declarations go in front of the converted line at
+    // declarations_position, the includes in front of the output line (with
+    // the declarations counted) at includes_position.
+    template<typename Emit>
+    class PrologueSplicer {
+    public:
+        PrologueSplicer(Prologue const* prologue, Emit emit)
+            : m_prologue(prologue)
+            , m_emit(std::move(emit))
+        {
+        }
+
+        void add(std::string_view line)
+        {
+            write_declarations_if_due();
+            write(line);
+            m_converted_index++;
+        }
+        void finish()
+        {
+            write_declarations_if_due();
+            write_includes_if_due();
+        }
+
+    private:
+        void write_includes_if_due()
+        {
+            if (!m_prologue || m_includes_written || m_position != m_prologue->includes_position)
+                return;
+            for (auto const& include : m_prologue->includes)
+                m_emit(include);
+            m_includes_written = true;
+        }
+        void write(std::string_view line)
+        {
+            write_includes_if_due();
+            m_emit(line);
+            m_position++;
+        }
+        void write_declarations_if_due()
+        {
+            if (!m_prologue || m_declarations_written || m_converted_index != m_prologue->declarations_position)
+                return;
+            for (auto const& declaration : m_prologue->declarations)
+                write(declaration);
+            m_declarations_written = true;
+        }
+
+        Prologue const* m_prologue;
+        Emit m_emit;
+        int m_converted_index { 0 };
+        int m_position { 0 };
+        bool m_declarations_written { false };
+        bool m_includes_written { false };
+    };
+
+    // The converted lines of a file, without the prologue.
+    struct ConvertedLines {
+        std::pmr::vector<std::pmr::string> lines;
+        std::optional<Prologue> prologue;
+    };
+    ConvertedLines convert_lines(FileId file);
+
+    IncludeRewriter& include_rewriter();
+    // Sets the flag of a header the prologue knows, other headers are included
+    // after those.
+    void require_header(ConversionState& state, std::string_view header);
+    void rewrite_identifiers(std::pmr::string& line, ConversionState& state, RuleSet::IdentifierPass pass);
+    void rewrite_literals(std::pmr::string& line, ConversionState& state);
+    // Rewrites the source line at `row` of `tokens`. Returns false if the line
+    // is dropped from the output.
+    bool convert_line(FileId file, PackedTokens const& tokens, int row, std::pmr::string& line, ConversionState& state);
+    // convert_line() through m_line_cache.
+    bool convert_line_cached(FileId file, PackedTokens const& tokens, int row, std::pmr::string& line, ConversionState& state);
+    // Notes #pragma once and the #include lines of the output line at `index`.
+    void track_output_line(ConversionState& state, std::string_view line, int index);
+    // Leaves out the includes the converted lines already have.
+    std::optional<Prologue> plan_prologue(ConversionState const& state);
+
+    // A rule that matched the current line, rewrite() and count_rewrite()
+    // are charged to it.
+    void begin_rule(std::string_view name);
+    // Whether `line` has the anchor of `rule`, which then becomes the current
+    // rule. A line matched by a rule that looks at tokens depends on more
+    // than its text.
+    bool rule_matches(std::string_view line, RuleSet::CodeRule rule);
+    void rewrite(std::pmr::string& line, std::string_view text_to_replace, std::string_view replacement);
+    void count_rewrite();
+    void count_rewrites(size_t replacements);
+
+    FileId streaming_window_file();
+    template<typename Callback>
+    void for_each_streamed_line(std::istream& input, size_t window_lines, ConversionState& state, Callback on_converted_line);
+
+    template<typename... Args>
+    std::pmr::string format(fmt::format_string<Args...> format_string, Args&&... args) {
+        std::pmr::string result { m_arena };
+        fmt::format_to(std::back_inserter(result), format_string, std::forward<Args>(args)...);
+        return result;
+    }
+
+    // Pre-scan of the whole file for the anchors of the rules that look at
+    // tokens. Files without any are converted from their text alone, they are
+    // neither lexed nor seen by the engine.
+    bool needs_tokens(FileId file);
+    PackedTokens const& tokens_for(FileId file);
+    std::pmr::string get_token_string(FileId file, PackedToken const& token_info);
+    std::pmr::string token_string(FileId file, int token_index, PackedTokens const& tiv);
+    std::optional<std::pmr::string> object_text(FileId file, int line, int position, PackedTokens const& tiv);
+    std::optional<std::pmr::string> find_parent_token_type(FileId file, int line, int position, PackedTokens const& tiv);
+    // The name of the type whose declaration the engine finds for `token`.
+    std::optional<std::pmr::string> declared_type_from_engine(FileId file, PackedToken const& token);
+    // The text of a token that doesn't span lines, without a copy.
+    std::string_view token_view(FileId file, PackedToken const& token);
+
+    // The declared type of the expression that ends with the token at `end`,
+    // worked out from m_symbol_database and the AkTypeModel: a member of the
+    // enclosing class, or a chain of member accesses, calls and subscripts
+    // like `m_node->children().first()`. The engine is only asked for the
+    // head of a chain that is not a member, and only if `ask_engine` is set.
+    std::optional<std::string> expression_type(FileId file, size_t end, PackedTokens const& tiv, bool ask_engine, int depth = 0);
+    // The type of the member named by the token at `name`: of the object in
+    // front of its `.` or `->`, otherwise of the enclosing class.
+    std::optional<std::string> accessed_member_type(FileId file, size_t name, PackedTokens const& tiv, int depth);
+    // The class whose scope the token at `index` of the file's tokens is in.
+    std::optional<std::string_view> enclosing_class_name(FileId file, size_t index, PackedTokens const& tiv);
+    // The type of `member` of the type `owner`, from the AK type model or the
+    // symbol database.
+    std::optional<std::string> member_type(std::string const& owner, std::string_view member) const;
+    // What -> on a value of `type` reaches.
+    std::optional<std::string> arrow_type(std::string const& type) const;
+    bool token_is_left_paren(FileId file, int token_index, PackedTokens const& tiv);
+    bool token_is_right_paren(FileId file, int token_index, PackedTokens const& tiv);
+    std::optional<std::pmr::string> text_between_matching_parens(FileId file, int line, int position, PackedTokens const& tiv);
+    std::pmr::string get_whitespace_between_tokens(FileId file, int prev_token, int token, PackedTokens const& tiv);
+    std::optional<int> position_of_last_matching_paren(FileId file, int line, int position, PackedTokens const& tiv);
+};
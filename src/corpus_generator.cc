@@ -0,0 +1,395 @@
+#include "corpus_generator.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <fmt/format.h>
+
+ConstructMix parse_construct_mix(std::string_view text) {
+    ConstructMix mix;
+    while (!text.empty()) {
+        auto end = text.find(',');
+        auto entry = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+        auto equals = entry.find('=');
+        if (equals == std::string_view::npos)
+            throw std::runtime_error(fmt::format("expected <construct>=<weight>, got '{}'", entry));
+        auto name = entry.substr(0, equals);
+        auto weight_text = entry.substr(equals + 1);
+        unsigned weight = 0;
+        auto [end_of_number, error] = std::from_chars(weight_text.data(), weight_text.data() + weight_text.size(), weight);
+        if (error != std::errc {} || end_of_number != weight_text.data() + weight_text.size())
+            throw std::runtime_error(fmt::format("invalid weight '{}' for {}", weight_text, name));
+
+        if (name == "string_builder")
+            mix.string_builder = weight;
+        else if (name == "appendff")
+            mix.appendff = weight;
+        else if (name == "extend")
+            mix.extend = weight;
+        else if (name == "adopt_ref")
+            mix.adopt_ref = weight;
+        else if (name == "nonnull_vector")
+            mix.nonnull_vector = weight;
+        else if (name == "lookup")
+            mix.lookup = weight;
+        else if (name == "other")
+            mix.other = weight;
+        else if (name == "noncopyable_percent")
+            mix.noncopyable_percent = std::min(weight, 100u);
+        else
+            throw std::runtime_error(fmt::format("unknown construct '{}'", name));
+    }
+    return mix;
+}
+
+CorpusGenerator::CorpusGenerator(uint64_t seed, ConstructMix mix)
+    : m_state(seed)
+    , m_mix(mix)
+{
+}
+
+// splitmix64, unlike the <random> distributions it is the same everywhere.
+uint64_t CorpusGenerator::next() {
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+std::string_view CorpusGenerator::pick(std::initializer_list<std::string_view> choices) {
+    return choices.begin()[next_below(choices.size())];
+}
+
+CorpusGenerator::Construct CorpusGenerator::pick_construct() {
+    std::pair<Construct, unsigned> const weights[] {
+        { Construct::StringBuilder, m_mix.string_builder },
+        { Construct::Appendff, m_mix.appendff },
+        { Construct::Extend, m_mix.extend },
+        { Construct::AdoptRef, m_mix.adopt_ref },
+        { Construct::NonnullVector, m_mix.nonnull_vector },
+        { Construct::Lookup, m_mix.lookup },
+        { Construct::Other, m_mix.other },
+    };
+    size_t total = 0;
+    for (auto const& [construct, weight] : weights)
+        total += weight;
+    if (!total)
+        return Construct::Other;
+
+    auto value = next_below(total);
+    for (auto const& [construct, weight] : weights) {
+        if (value < weight)
+            return construct;
+        value -= weight;
+    }
+    return Construct::Other;
+}
+
+static void append_lines(std::string& out, size_t& lines, std::string_view text) {
+    out += text;
+    lines += std::count(text.begin(), text.end(), '\n');
+}
+
+void CorpusGenerator::append_method(std::string& out, size_t& lines, std::string const& class_name) {
+    auto id = next_below(1000000);
+    switch (pick_construct()) {
+    case Construct::StringBuilder:
+        append_lines(out, lines, fmt::format(
+            "    ByteString describe_{}() const\n"
+            "    {{\n"
+            "        StringBuilder builder;\n"
+            "        builder.append('(');\n"
+            "        builder.append(m_filename);\n"
+            "        builder.append(\"){}\"sv);\n"
+            "        return builder.to_byte_string();\n"
+            "    }}\n\n",
+            id, pick({ "", " ", ";" })));
+        break;
+    case Construct::Appendff:
+        append_lines(out, lines, fmt::format(
+            "    ByteString format_{}() const\n"
+            "    {{\n"
+            "        StringBuilder builder;\n"
+            "        builder.appendff(\"{{}}:{{}}\", m_name.value_or(ByteString::empty()), {});\n"
+            "        return builder.to_byte_string();\n"
+            "    }}\n\n",
+            id, id));
+        break;
+    case Construct::Extend:
+        append_lines(out, lines, fmt::format(
+            "    void merge_{}({} const& other)\n"
+            "    {{\n"
+            "        m_children.extend(other.m_children);\n"
+            "        VERIFY(!m_children.is_empty());\n"
+            "    }}\n\n",
+            id, class_name));
+        break;
+    case Construct::AdoptRef:
+        append_lines(out, lines, fmt::format(
+            "    NonnullRefPtr<{0}> clone_{1}() const\n"
+            "    {{\n"
+            "        auto node = adopt_ref(*new {0}());\n"
+            "        node->m_name = m_name;\n"
+            "        node->m_filename = m_filename;\n"
+            "        return node;\n"
+            "    }}\n\n",
+            class_name, id));
+        break;
+    case Construct::NonnullVector:
+        append_lines(out, lines, fmt::format(
+            "    void add_{}(NonnullRefPtr<{}> child)\n"
+            "    {{\n"
+            "        child->m_parent = this;\n"
+            "        m_children.append(move(child));\n"
+            "    }}\n\n",
+            id, class_name));
+        break;
+    case Construct::Lookup:
+        if (next_below(2)) {
+            append_lines(out, lines, fmt::format(
+                "    Optional<size_t> find_{}(StringView name) const\n"
+                "    {{\n"
+                "        for (size_t i = 0; i < m_children.size(); ++i) {{\n"
+                "            if (m_children[i]->m_filename == name)\n"
+                "                return i;\n"
+                "        }}\n"
+                "        return {{}};\n"
+                "    }}\n\n",
+                id));
+        } else {
+            append_lines(out, lines, fmt::format(
+                "    ByteString first_name_{}() const {{ return m_children.first()->m_name.value_or(ByteString::empty()); }}\n\n",
+                id));
+        }
+        break;
+    case Construct::Other:
+        if (next_below(2)) {
+            append_lines(out, lines, fmt::format(
+                "    ByteString joined_{}() const\n"
+                "    {{\n"
+                "        Vector<ByteString> names;\n"
+                "        for (auto const& child : m_children)\n"
+                "            names.append(child->m_filename);\n"
+                "        dbgln_if(CPP_DEBUG, \"joining {{}} names\", names.size());\n"
+                "        return ByteString::join(\", \"sv, names);\n"
+                "    }}\n\n",
+                id));
+        } else {
+            append_lines(out, lines, fmt::format(
+                "    // Returns the parent, {} ({}).\n"
+                "    RefPtr<{}> parent_{}() const {{ return m_parent.ptr(); }}\n\n",
+                pick({ "if there is one", "may be null", "set by add()" }), id, class_name, id));
+        }
+        break;
+    }
+}
+
+void CorpusGenerator::append_function(std::string& out, size_t& lines, std::string const& class_name) {
+    auto id = next_below(1000000);
+    switch (pick_construct()) {
+    case Construct::StringBuilder:
+        append_lines(out, lines, fmt::format(
+            "ByteString describe_{0}_{1}({0} const& node)\n"
+            "{{\n"
+            "    StringBuilder builder;\n"
+            "    builder.append(\"{0} \"sv);\n"
+            "    builder.append(node.class_name());\n"
+            "    builder.append('\\n');\n"
+            "    return builder.to_byte_string();\n"
+            "}}\n\n",
+            class_name, id));
+        break;
+    case Construct::Appendff:
+        append_lines(out, lines, fmt::format(
+            "ByteString summary_{}(Vector<ByteString> const& names)\n"
+            "{{\n"
+            "    StringBuilder builder;\n"
+            "    builder.appendff(\"{{}} names, first {{}}\", names.size(), names.first());\n"
+            "    return builder.to_byte_string();\n"
+            "}}\n\n",
+            id));
+        break;
+    case Construct::Extend:
+        append_lines(out, lines, fmt::format(
+            "void collect_{1}(Vector<NonnullRefPtr<{0}>>& into, Vector<NonnullRefPtr<{0}>> const& from)\n"
+            "{{\n"
+            "    into.extend(from);\n"
+            "}}\n\n",
+            class_name, id));
+        break;
+    case Construct::AdoptRef:
+        append_lines(out, lines, fmt::format(
+            "NonnullRefPtr<{0}> make_{1}()\n"
+            "{{\n"
+            "    return adopt_ref(*new {0}());\n"
+            "}}\n\n",
+            class_name, id));
+        break;
+    case Construct::NonnullVector:
+        append_lines(out, lines, fmt::format(
+            "Vector<NonnullRefPtr<{0}>> make_many_{1}(size_t count)\n"
+            "{{\n"
+            "    Vector<NonnullRefPtr<{0}>> nodes;\n"
+            "    for (size_t i = 0; i < count; ++i)\n"
+            "        nodes.append(adopt_ref(*new {0}()));\n"
+            "    return nodes;\n"
+            "}}\n\n",
+            class_name, id));
+        break;
+    case Construct::Lookup:
+        append_lines(out, lines, fmt::format(
+            "Optional<size_t> index_of_{}(Vector<ByteString> const& names, StringView name)\n"
+            "{{\n"
+            "    for (size_t i = 0; i < names.size(); ++i) {{\n"
+            "        if (names[i] == name)\n"
+            "            return i;\n"
+            "    }}\n"
+            "    return {{}};\n"
+            "}}\n\n",
+            id));
+        break;
+    case Construct::Other:
+        append_lines(out, lines, fmt::format(
+            "ByteString first_of_{}(Vector<ByteString> const& names)\n"
+            "{{\n"
+            "    VERIFY(!names.is_empty());\n"
+            "    return names.first();\n"
+            "}}\n\n",
+            id));
+        break;
+    }
+}
+
+void CorpusGenerator::append_class(std::string& out, size_t& lines, std::vector<size_t> const& related_classes) {
+    auto class_name = fmt::format("Node{}", m_next_class);
+    append_lines(out, lines, fmt::format("class {0} : public RefCounted<{0}> {{\n", class_name));
+    if (next_below(100) < m_mix.noncopyable_percent)
+        append_lines(out, lines, fmt::format("    AK_MAKE_NONCOPYABLE({});\n\n", class_name));
+    append_lines(out, lines, fmt::format(
+        "public:\n"
+        "    {0}() = default;\n"
+        "    StringView class_name() const {{ return \"{0}\"sv; }}\n\n",
+        class_name));
+
+    auto methods = 2 + next_below(12);
+    for (size_t i = 0; i < methods; ++i)
+        append_method(out, lines, class_name);
+
+    append_lines(out, lines, fmt::format(
+        "private:\n"
+        "    Vector<NonnullRefPtr<{0}>> m_children;\n"
+        "    Optional<ByteString> m_name;\n"
+        "    RefPtr<{0}> m_parent;\n"
+        "    DeprecatedFlyString m_filename;\n",
+        class_name));
+    if (!related_classes.empty()) {
+        auto related = related_classes[next_below(related_classes.size())];
+        append_lines(out, lines, fmt::format("    Vector<NonnullRefPtr<Node{0}>> m_related_{0};\n", related));
+    }
+    append_lines(out, lines, "};\n\n");
+    m_next_class++;
+}
+
+static constexpr std::string_view ak_includes =
+    "#include <AK/ByteString.h>\n"
+    "#include <AK/DeprecatedFlyString.h>\n"
+    "#include <AK/Optional.h>\n"
+    "#include <AK/RefCounted.h>\n"
+    "#include <AK/StringBuilder.h>\n"
+    "#include <AK/StringView.h>\n"
+    "#include <AK/Vector.h>\n";
+
+std::string CorpusGenerator::generate_header(std::string_view name, size_t lines) {
+    std::string out;
+    size_t line_count = 0;
+    append_lines(out, line_count, fmt::format(
+        "/*\n"
+        " * Generated AK style code: {}\n"
+        " */\n"
+        "\n"
+        "#pragma once\n"
+        "\n"
+        "{}"
+        "\n"
+        "namespace Generated {{\n\n",
+        name, ak_includes));
+    while (line_count + 2 < lines)
+        append_class(out, line_count, {});
+    append_lines(out, line_count, "}\n");
+    return out;
+}
+
+std::vector<GeneratedFile> CorpusGenerator::generate_project(ProjectOptions const& options) {
+    std::vector<GeneratedFile> files;
+    // The classes every module's header defines.
+    std::vector<std::vector<size_t>> module_classes;
+
+    auto header_name = [](size_t module) { return fmt::format("Module{}.h", module); };
+    auto pick_included_modules = [&](size_t module) {
+        std::vector<size_t> included;
+        auto count = std::min(options.includes_per_file, module);
+        while (included.size() < count) {
+            auto candidate = next_below(module);
+            if (std::find(included.begin(), included.end(), candidate) == included.end())
+                included.push_back(candidate);
+        }
+        std::sort(included.begin(), included.end());
+        return included;
+    };
+
+    for (size_t module = 0; module < options.modules; ++module) {
+        auto header_includes = pick_included_modules(module);
+        std::vector<size_t> related_classes;
+        for (auto included : header_includes)
+            related_classes.insert(related_classes.end(), module_classes[included].begin(), module_classes[included].end());
+
+        std::string header;
+        size_t header_lines = 0;
+        append_lines(header, header_lines, fmt::format(
+            "/*\n"
+            " * Generated AK style code: {}\n"
+            " */\n"
+            "\n"
+            "#pragma once\n"
+            "\n"
+            "{}",
+            header_name(module), ak_includes));
+        for (auto included : header_includes)
+            append_lines(header, header_lines, fmt::format("#include \"{}\"\n", header_name(included)));
+        append_lines(header, header_lines, "\nnamespace Generated {\n\n");
+
+        auto& classes = module_classes.emplace_back();
+        do {
+            classes.push_back(m_next_class);
+            append_class(header, header_lines, related_classes);
+        } while (header_lines + 2 < options.lines_per_file);
+        append_lines(header, header_lines, "}\n");
+        files.push_back({ fmt::format("Lib/{}", header_name(module)), std::move(header) });
+
+        // The source uses its own classes and the ones of the headers it includes.
+        auto source_includes = pick_included_modules(module);
+        std::vector<size_t> usable_classes = classes;
+        for (auto included : source_includes)
+            usable_classes.insert(usable_classes.end(), module_classes[included].begin(), module_classes[included].end());
+
+        std::string source;
+        size_t source_lines = 0;
+        append_lines(source, source_lines, fmt::format(
+            "/*\n"
+            " * Generated AK style code: Module{}.cpp\n"
+            " */\n"
+            "\n"
+            "#include \"{}\"\n",
+            module, header_name(module)));
+        for (auto included : source_includes)
+            append_lines(source, source_lines, fmt::format("#include \"{}\"\n", header_name(included)));
+        append_lines(source, source_lines, "\nnamespace Generated {\n\n");
+        do {
+            append_function(source, source_lines, fmt::format("Node{}", usable_classes[next_below(usable_classes.size())]));
+        } while (source_lines + 2 < options.lines_per_file);
+        append_lines(source, source_lines, "}\n");
+        files.push_back({ fmt::format("Lib/Module{}.cpp", module), std::move(source) });
+    }
+    return files;
+}
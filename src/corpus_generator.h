@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Relative weights of the AK constructs the generated methods and functions
+// are built around. A weight of 0 leaves the construct out.
+struct ConstructMix {
+    // StringBuilder with append() of chars and strings, then to_byte_string().
+    unsigned string_builder { 3 };
+    unsigned appendff { 2 };
+    unsigned extend { 2 };
+    // adopt_ref(*new ...)
+    unsigned adopt_ref { 2 };
+    // Vector<NonnullRefPtr<...>> locals that are appended to.
+    unsigned nonnull_vector { 2 };
+    // Optional, StringView and first() lookups.
+    unsigned lookup { 2 };
+    // ByteString::join, ptr(), comments.
+    unsigned other { 2 };
+    // Share of the classes that use AK_MAKE_NONCOPYABLE.
+    unsigned noncopyable_percent { 50 };
+};
+
+// Parses a comma separated list like "string_builder=5,extend=0,noncopyable_percent=100",
+// constructs that are not listed keep their default weight. Throws
+// std::runtime_error on unknown names or malformed weights.
+ConstructMix parse_construct_mix(std::string_view text);
+
+struct ProjectOptions {
+    // Every module is a header and a source file.
+    size_t modules { 16 };
+    size_t lines_per_file { 500 };
+    // How many headers of other modules each header and source includes.
+    size_t includes_per_file { 3 };
+};
+
+struct GeneratedFile {
+    // Relative to the project root.
+    std::string path;
+    std::string content;
+};
+
+// Generates AK style C++ that exercises the conversion rules. The output only
+// depends on the seed, the mix and the options, the same seed gives the same
+// bytes on every platform.
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(uint64_t seed, ConstructMix mix = {});
+
+    // A self-contained header of about `lines` lines.
+    std::string generate_header(std::string_view name, size_t lines);
+
+    // Headers and sources in Lib/. Module i's files only include headers of
+    // modules before it, so the include graph has no cycles.
+    std::vector<GeneratedFile> generate_project(ProjectOptions const& options);
+
+private:
+    enum class Construct {
+        StringBuilder,
+        Appendff,
+        Extend,
+        AdoptRef,
+        NonnullVector,
+        Lookup,
+        Other,
+    };
+
+    uint64_t next();
+    size_t next_below(size_t bound) { return static_cast<size_t>(next() % bound); }
+    std::string_view pick(std::initializer_list<std::string_view> choices);
+    Construct pick_construct();
+
+    void append_class(std::string& out, size_t& lines, std::vector<size_t> const& related_classes);
+    void append_method(std::string& out, size_t& lines, std::string const& class_name);
+    void append_function(std::string& out, size_t& lines, std::string const& class_name);
+
+    uint64_t m_state;
+    ConstructMix m_mix;
+    size_t m_next_class { 0 };
+};
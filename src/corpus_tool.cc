@@ -0,0 +1,79 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "convert_ak_to_std.h"
+#include "corpus_generator.h"
+#include "file_io.h"
+
+// Writes a generated AK style project and a compile_commands.json for its
+// sources, to stress the batch conversion with more than the test files.
+//
+//   ak-to-std-corpus <out-dir> [--seed <n>] [--modules <n>] [--lines <n>]
+//                    [--includes <n>] [--mix <construct>=<weight>,...]
+
+static void write_compile_commands(std::filesystem::path const& root, std::vector<GeneratedFile> const& files) {
+    std::ofstream file(root / "compile_commands.json");
+    file << "[";
+    bool first = true;
+    for (auto const& generated : files) {
+        if (!generated.path.ends_with(".cpp"))
+            continue;
+        file << fmt::format("{}\n  {{ \"directory\": {}, \"file\": {}, \"arguments\": [\"c++\", \"-std=c++20\", {}, \"-c\", {}] }}",
+            first ? "" : ",", json_string(root.string()), json_string(generated.path),
+            json_string(fmt::format("-I{}", (root / "Lib").string())), json_string(generated.path));
+        first = false;
+    }
+    file << "\n]\n";
+}
+
+int main(int argc, char* argv[]) {
+    auto usage = [] {
+        outln("Usage: ak-to-std-corpus <out-dir> [--seed <n>] [--modules <n>] [--lines <n>] [--includes <n>] [--mix <construct>=<weight>,...]");
+        outln("       constructs: string_builder, appendff, extend, adopt_ref, nonnull_vector, lookup, other, noncopyable_percent");
+        return -1;
+    };
+    if (argc < 2)
+        return usage();
+
+    std::filesystem::path root = std::filesystem::absolute(argv[1]);
+    uint64_t seed = 1;
+    ConstructMix mix;
+    ProjectOptions options;
+    try {
+        for (int i = 2; i < argc; ++i) {
+            std::string argument = argv[i];
+            if (i + 1 >= argc)
+                return usage();
+            if (argument == "--seed")
+                seed = std::stoull(argv[++i]);
+            else if (argument == "--modules")
+                options.modules = std::stoull(argv[++i]);
+            else if (argument == "--lines")
+                options.lines_per_file = std::stoull(argv[++i]);
+            else if (argument == "--includes")
+                options.includes_per_file = std::stoull(argv[++i]);
+            else if (argument == "--mix")
+                mix = parse_construct_mix(argv[++i]);
+            else
+                return usage();
+        }
+    } catch (std::exception const& e) {
+        outln("{}", e.what());
+        return -1;
+    }
+
+    auto files = CorpusGenerator(seed, mix).generate_project(options);
+    size_t lines = 0;
+    size_t bytes = 0;
+    for (auto const& file : files) {
+        auto content = split_into_lines(file.content);
+        lines += content.size();
+        bytes += file.content.size();
+        write_output_file(root / file.path, content);
+    }
+    write_compile_commands(root, files);
+
+    outln("{} files, {} lines, {} bytes in {}", files.size(), lines, bytes, root.string());
+    return 0;
+}
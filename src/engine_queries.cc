@@ -0,0 +1,199 @@
+#include "engine_queries.h"
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <fmt/format.h>
+#include "local_filedb.h"
+
+EngineQueryRecorder::EngineQueryRecorder(std::string const& path)
+    : m_file(path, std::ios::binary)
+{
+    if (!m_file)
+        throw std::runtime_error(fmt::format("unable to write {}", path));
+}
+
+uint32_t EngineQueryRecorder::new_stream() {
+    std::lock_guard lock(m_mutex);
+    return m_next_stream++;
+}
+
+void EngineQueryRecorder::engine_created(uint32_t stream) {
+    std::lock_guard lock(m_mutex);
+    m_file << fmt::format("engine {}\n", stream);
+}
+
+void EngineQueryRecorder::file_read(uint32_t stream, std::string const& path, std::string const& content) {
+    auto hash = std::hash<std::string> {}(content);
+    std::lock_guard lock(m_mutex);
+    auto [it, inserted] = m_recorded_content_hashes.try_emplace({ stream, path }, hash);
+    if (!inserted && it->second == hash)
+        return;
+    it->second = hash;
+    m_file << fmt::format("file {} {} {}\n", stream, content.size(), path) << content << '\n';
+}
+
+void EngineQueryRecorder::file_edited(uint32_t stream, std::string const& path) {
+    std::lock_guard lock(m_mutex);
+    m_file << fmt::format("edit {} {}\n", stream, path);
+}
+
+void EngineQueryRecorder::declaration(uint32_t stream, std::string const& path, size_t line, size_t column, std::optional<CodeComprehension::ProjectLocation> const& result) {
+    std::lock_guard lock(m_mutex);
+    m_file << fmt::format("declaration {} {} {} {}\n", stream, line, column, path);
+    if (result)
+        m_file << fmt::format("-> {} {} {}\n", result->line, result->column, result->file);
+    else
+        m_file << "-> none\n";
+}
+
+namespace {
+
+// Splits off the next space separated field of `line`.
+std::string_view next_field(std::string_view& line) {
+    auto end = line.find(' ');
+    auto field = line.substr(0, end);
+    line.remove_prefix(end == std::string_view::npos ? line.size() : end + 1);
+    return field;
+}
+
+size_t next_number(std::string_view& line) {
+    auto field = next_field(line);
+    size_t value = 0;
+    auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (error != std::errc {} || end != field.data() + field.size())
+        throw std::invalid_argument(fmt::format("expected a number, got '{}'", field));
+    return value;
+}
+
+class LogReader {
+public:
+    explicit LogReader(std::string const& path)
+        : m_file(path, std::ios::binary)
+        , m_path(path)
+    {
+        if (!m_file)
+            throw std::runtime_error(fmt::format("unable to read {}", path));
+    }
+
+    bool next_line(std::string& line) {
+        if (!std::getline(m_file, line))
+            return false;
+        m_line_number++;
+        return true;
+    }
+
+    std::string line() {
+        std::string line;
+        if (!next_line(line))
+            fail("unexpected end of file");
+        return line;
+    }
+
+    std::string bytes(size_t size) {
+        std::string content(size, '\0');
+        if (!m_file.read(content.data(), size) || m_file.get() != '\n')
+            fail("truncated file content");
+        m_line_number += std::count(content.begin(), content.end(), '\n') + 1;
+        return content;
+    }
+
+    [[noreturn]] void fail(std::string_view message) const {
+        throw std::runtime_error(fmt::format("{}:{}: {}", m_path, m_line_number, message));
+    }
+
+private:
+    std::ifstream m_file;
+    std::string m_path;
+    size_t m_line_number { 0 };
+};
+
+}
+
+std::vector<EngineQuery> read_engine_queries(std::string const& path) {
+    LogReader reader(path);
+    std::vector<EngineQuery> queries;
+    std::string text;
+    while (reader.next_line(text)) {
+        std::string_view line = text;
+        auto kind = next_field(line);
+        EngineQuery query;
+        try {
+            query.stream = next_number(line);
+            if (kind == "engine") {
+                query.kind = EngineQuery::Kind::Engine;
+            } else if (kind == "file") {
+                query.kind = EngineQuery::Kind::File;
+                auto size = next_number(line);
+                query.path = line;
+                query.content = reader.bytes(size);
+            } else if (kind == "edit") {
+                query.kind = EngineQuery::Kind::Edit;
+                query.path = line;
+            } else if (kind == "declaration") {
+                query.kind = EngineQuery::Kind::Declaration;
+                query.line = next_number(line);
+                query.column = next_number(line);
+                query.path = line;
+
+                auto result_text = reader.line();
+                std::string_view result = result_text;
+                if (next_field(result) != "->")
+                    reader.fail("expected the result of a declaration query");
+                if (result != "none") {
+                    CodeComprehension::ProjectLocation location;
+                    location.line = next_number(result);
+                    location.column = next_number(result);
+                    location.file = result;
+                    query.declaration = std::move(location);
+                }
+            } else {
+                reader.fail(fmt::format("unknown query '{}'", kind));
+            }
+        } catch (std::invalid_argument const& e) {
+            reader.fail(e.what());
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+ReplayResult replay_engine_queries(std::vector<EngineQuery> const& queries) {
+    struct Stream {
+        LocalFileDB filedb;
+        std::unique_ptr<CodeComprehension::Cpp::CppComprehensionEngine> engine;
+    };
+    std::map<uint32_t, Stream> streams;
+    ReplayResult result;
+
+    for (auto const& query : queries) {
+        auto& stream = streams[query.stream];
+        if (query.kind == EngineQuery::Kind::File) {
+            stream.filedb.add(query.path, query.content);
+            continue;
+        }
+        if (query.kind == EngineQuery::Kind::Engine || !stream.engine)
+            stream.engine = std::make_unique<CodeComprehension::Cpp::CppComprehensionEngine>(stream.filedb);
+
+        switch (query.kind) {
+        case EngineQuery::Kind::Engine:
+        case EngineQuery::Kind::File:
+            break;
+        case EngineQuery::Kind::Edit:
+            stream.engine->on_edit(query.path);
+            break;
+        case EngineQuery::Kind::Declaration: {
+            result.declaration_queries++;
+            auto declaration = stream.engine->find_declaration_of(query.path, { query.line, query.column });
+            bool same = declaration.has_value() == query.declaration.has_value()
+                && (!declaration || (declaration->file == query.declaration->file && declaration->line == query.declaration->line && declaration->column == query.declaration->column));
+            if (!same)
+                result.mismatches++;
+            break;
+        }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cpp/cppcomprehensionengine.hh>
+
+// Records every query converters make to their comprehension engines, with
+// the results and the content of every file the engines read, so that the
+// same query stream can be replayed against the engine alone.
+//
+// The log is line based text. Every converter writes its own stream, the
+// queries of one stream are in the order they were made:
+//
+//   engine <stream>                          a new engine was created
+//   file <stream> <size> <path>              followed by <size> bytes and a newline
+//   edit <stream> <path>                     on_edit() was called
+//   declaration <stream> <line> <column> <path>
+//   -> <line> <column> <path>                or "-> none"
+//
+// One recorder can be shared by several threads.
+class EngineQueryRecorder {
+public:
+    // Throws std::runtime_error if the file can't be created.
+    explicit EngineQueryRecorder(std::string const& path);
+
+    uint32_t new_stream();
+
+    void engine_created(uint32_t stream);
+    // Writes the content only if it changed since it was last recorded.
+    void file_read(uint32_t stream, std::string const& path, std::string const& content);
+    void file_edited(uint32_t stream, std::string const& path);
+    void declaration(uint32_t stream, std::string const& path, size_t line, size_t column, std::optional<CodeComprehension::ProjectLocation> const& result);
+
+private:
+    std::mutex m_mutex;
+    std::ofstream m_file;
+    uint32_t m_next_stream { 0 };
+    std::map<std::pair<uint32_t, std::string>, size_t> m_recorded_content_hashes;
+};
+
+struct EngineQuery {
+    enum class Kind {
+        Engine,
+        File,
+        Edit,
+        Declaration,
+    };
+
+    Kind kind { Kind::Engine };
+    uint32_t stream { 0 };
+    std::string path;
+    // File
+    std::string content;
+    // Declaration
+    size_t line { 0 };
+    size_t column { 0 };
+    // Recorded result
+    std::optional<CodeComprehension::ProjectLocation> declaration;
+};
+
+// Throws std::runtime_error if the log can't be read or is malformed.
+std::vector<EngineQuery> read_engine_queries(std::string const& path);
+
+struct ReplayResult {
+    size_t declaration_queries { 0 };
+    // Queries whose result differs from the recorded one.
+    size_t mismatches { 0 };
+};
+
+// Runs the queries against fresh engines, one per recorded stream, that only
+// see the recorded file contents.
+ReplayResult replay_engine_queries(std::vector<EngineQuery> const& queries);
@@ -0,0 +1,108 @@
+#include "file_io.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string read_file(std::filesystem::path const& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error(fmt::format("unable to load file {}", path.string()));
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+void write_output_file(std::filesystem::path const& output_file_path, std::vector<std::string> const& output_content)
+{
+    if (output_file_path.has_parent_path())
+        std::filesystem::create_directories(output_file_path.parent_path());
+
+    std::ofstream output(output_file_path);
+    if(output.is_open()) {
+        for(auto const& line : output_content) {
+            output << line << std::endl;
+        }
+    }
+}
+
+namespace {
+
+class FileDescriptor {
+public:
+    FileDescriptor(std::filesystem::path const& path, int flags)
+        : m_fd(open(path.c_str(), flags | O_CLOEXEC, 0644))
+    {
+        if (m_fd < 0)
+            throw std::runtime_error(fmt::format("unable to open {}: {}", path.string(), strerror(errno)));
+    }
+    ~FileDescriptor() { close(m_fd); }
+
+    FileDescriptor(FileDescriptor const&) = delete;
+    FileDescriptor& operator=(FileDescriptor const&) = delete;
+
+    int fd() const { return m_fd; }
+
+private:
+    int m_fd;
+};
+
+void write_all(int fd, char const* data, size_t size, std::filesystem::path const& path)
+{
+    while (size) {
+        auto written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw std::runtime_error(fmt::format("unable to write {}: {}", path.string(), strerror(errno)));
+        data += written;
+        size -= written;
+    }
+}
+
+}
+
+void copy_output_file(std::filesystem::path const& source, std::filesystem::path const& output_file_path)
+{
+    if (output_file_path.has_parent_path())
+        std::filesystem::create_directories(output_file_path.parent_path());
+
+    FileDescriptor input(source, O_RDONLY);
+    FileDescriptor output(output_file_path, O_WRONLY | O_CREAT | O_TRUNC);
+    struct stat status {};
+    if (fstat(input.fd(), &status) != 0)
+        throw std::runtime_error(fmt::format("unable to stat {}: {}", source.string(), strerror(errno)));
+
+    size_t remaining = status.st_size;
+    while (remaining) {
+        auto copied = copy_file_range(input.fd(), nullptr, output.fd(), nullptr, remaining, 0);
+        if (copied < 0 && errno == EINTR)
+            continue;
+        if (copied <= 0)
+            break;
+        remaining -= copied;
+    }
+    // Not supported between these file systems (or by this kernel), copy the rest through user space.
+    char buffer[64 * 1024];
+    while (remaining) {
+        auto read_bytes = read(input.fd(), buffer, sizeof(buffer));
+        if (read_bytes < 0 && errno == EINTR)
+            continue;
+        if (read_bytes <= 0)
+            throw std::runtime_error(fmt::format("unable to read {}: {}", source.string(), strerror(errno)));
+        write_all(output.fd(), buffer, read_bytes, output_file_path);
+        remaining -= read_bytes;
+    }
+
+    char last = '\n';
+    if (status.st_size && pread(input.fd(), &last, 1, status.st_size - 1) != 1)
+        throw std::runtime_error(fmt::format("unable to read {}: {}", source.string(), strerror(errno)));
+    if (last != '\n')
+        write_all(output.fd(), "\n", 1, output_file_path);
+}
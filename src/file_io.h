@@ -0,0 +1,15 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Throws std::runtime_error if the file can't be read.
+std::string read_file(std::filesystem::path const& path);
+
+// Writes the lines newline terminated, creating missing parent directories.
+void write_output_file(std::filesystem::path const& output_file_path, std::vector<std::string> const& output_content);
+
+// Writes what write_output_file() would write for the lines of `source`, i.e.
+// `source` with a newline after its last line, by copying it inside the kernel
+// (copy_file_range) where possible. Throws std::runtime_error on failure.
+void copy_output_file(std::filesystem::path const& source, std::filesystem::path const& output_file_path);
@@ -0,0 +1,131 @@
+#include "file_watcher.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static constexpr uint32_t file_events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+
+FileWatcher::FileWatcher(std::filesystem::path root)
+    : m_root(std::move(root))
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        throw std::runtime_error(fmt::format("inotify_init1: {}", strerror(errno)));
+    add_watch_recursive("");
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+void FileWatcher::add_watch(std::filesystem::path const& relative_directory)
+{
+    auto full_path = m_root / relative_directory;
+    int wd = inotify_add_watch(m_fd, full_path.c_str(), file_events);
+    if (wd < 0)
+        throw std::runtime_error(fmt::format("inotify_add_watch({}): {}", full_path.string(), strerror(errno)));
+    m_watched_directories[wd] = relative_directory;
+}
+
+void FileWatcher::add_watch_recursive(std::filesystem::path const& relative_directory, std::set<std::string>* changed)
+{
+    add_watch(relative_directory);
+    for (auto const& entry : std::filesystem::recursive_directory_iterator(m_root / relative_directory)) {
+        if (entry.is_directory())
+            add_watch(std::filesystem::relative(entry.path(), m_root));
+        else if (changed && entry.is_regular_file())
+            changed->insert(std::filesystem::relative(entry.path(), m_root).string());
+    }
+}
+
+void FileWatcher::remove_watches_below(std::filesystem::path const& relative_directory)
+{
+    auto prefix = relative_directory.string() + "/";
+    std::erase_if(m_watched_directories, [&](auto const& watch) {
+        auto path = watch.second.string();
+        if (path != relative_directory.string() && !path.starts_with(prefix))
+            return false;
+        inotify_rm_watch(m_fd, watch.first);
+        return true;
+    });
+}
+
+void FileWatcher::read_events(Changes& changes)
+{
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        auto nread = read(m_fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            if (errno == EAGAIN)
+                return;
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(fmt::format("read(inotify): {}", strerror(errno)));
+        }
+
+        for (char* ptr = buffer; ptr < buffer + nread;) {
+            auto const* event = reinterpret_cast<inotify_event const*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes.needs_rescan = true;
+                // Directories created meanwhile may not be watched yet.
+                try {
+                    add_watch_recursive("");
+                } catch (std::exception const&) {
+                    // A directory went away while it was listed, its removal is part of the rescan.
+                }
+                continue;
+            }
+
+            auto directory = m_watched_directories.find(event->wd);
+            if (directory == m_watched_directories.end() || event->len == 0)
+                continue;
+
+            auto relative_path = (directory->second / event->name).lexically_normal();
+            if (event->mask & IN_ISDIR) {
+                // Files can be in the directory before its watch is, e.g. if it was moved in.
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    try {
+                        add_watch_recursive(relative_path, &changes.files);
+                    } catch (std::exception const&) {
+                        // It is already gone again.
+                        changes.needs_rescan = true;
+                    }
+                } else if (event->mask & IN_MOVED_FROM) {
+                    remove_watches_below(relative_path);
+                    changes.needs_rescan = true;
+                }
+                continue;
+            }
+            // A freshly created file is reported again with IN_CLOSE_WRITE once it has content.
+            if (event->mask & IN_CREATE)
+                continue;
+            changes.files.insert(relative_path.string());
+        }
+    }
+}
+
+FileWatcher::Changes FileWatcher::wait_for_changes(std::chrono::milliseconds debounce)
+{
+    Changes changes;
+    pollfd pfd { m_fd, POLLIN, 0 };
+    while (true) {
+        int timeout = changes.files.empty() && !changes.needs_rescan ? -1 : static_cast<int>(debounce.count());
+        int rc = poll(&pfd, 1, timeout);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(fmt::format("poll(inotify): {}", strerror(errno)));
+        }
+        if (rc == 0)
+            return changes;
+        read_events(changes);
+    }
+}
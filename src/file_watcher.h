@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+
+// Watches a directory tree with inotify and reports which files changed.
+// Directories created or moved in after construction are picked up
+// automatically, together with the files already in them.
+class FileWatcher {
+public:
+    explicit FileWatcher(std::filesystem::path root);
+    ~FileWatcher();
+
+    FileWatcher(FileWatcher const&) = delete;
+    FileWatcher& operator=(FileWatcher const&) = delete;
+
+    struct Changes {
+        // Relative to the root.
+        std::set<std::string> files;
+        // The kernel dropped events or a directory was moved out of the tree:
+        // any file may have changed or disappeared without being reported.
+        bool needs_rescan { false };
+    };
+    // Blocks until at least one file changed and then keeps collecting changes
+    // until nothing happened for `debounce`.
+    Changes wait_for_changes(std::chrono::milliseconds debounce);
+
+private:
+    void add_watch(std::filesystem::path const& relative_directory);
+    // Also adds the files in the tree to `changed`, if given.
+    void add_watch_recursive(std::filesystem::path const& relative_directory, std::set<std::string>* changed = nullptr);
+    // Of a directory that left the tree and of everything in it.
+    void remove_watches_below(std::filesystem::path const& relative_directory);
+    void read_events(Changes& changes);
+
+    std::filesystem::path m_root;
+    int m_fd { -1 };
+    std::map<int, std::filesystem::path> m_watched_directories;
+};
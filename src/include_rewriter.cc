@@ -0,0 +1,132 @@
+#include "include_rewriter.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+IncludeRewriter::IncludeRewriter(RuleSet const& rules, std::string include_path)
+    : m_rules(rules.include_rules())
+    , m_include_path(std::move(include_path))
+{
+    m_trie.emplace_back();
+    for (uint32_t index = 0; index < m_rules.size(); ++index) {
+        m_rule_names.push_back("#include " + m_rules[index].from);
+        uint32_t node = 0;
+        for (auto c : m_rules[index].from) {
+            auto& children = m_trie[node].children;
+            auto child = std::ranges::lower_bound(children, c, {}, &std::pair<char, uint32_t>::first);
+            if (child == children.end() || child->first != c) {
+                auto next = static_cast<uint32_t>(m_trie.size());
+                children.insert(child, { c, next });
+                m_trie.emplace_back();
+                node = next;
+            } else {
+                node = child->second;
+            }
+        }
+        m_trie[node].rule = index;
+    }
+}
+
+std::optional<uint32_t> IncludeRewriter::longest_root(std::string_view argument) const
+{
+    std::optional<uint32_t> rule;
+    uint32_t node = 0;
+    for (auto c : argument) {
+        auto const& children = m_trie[node].children;
+        auto child = std::ranges::lower_bound(children, c, {}, &std::pair<char, uint32_t>::first);
+        if (child == children.end() || child->first != c)
+            break;
+        node = child->second;
+        if (m_trie[node].rule)
+            rule = m_trie[node].rule;
+    }
+    return rule;
+}
+
+// "EventLoop" -> "event_loop", "HTTPServer" -> "http_server".
+static void append_snake_case(std::string& output, std::string_view name)
+{
+    auto is_upper = [](char c) { return std::isupper(static_cast<unsigned char>(c)); };
+    auto is_lower_or_digit = [](char c) { return std::islower(static_cast<unsigned char>(c)) || std::isdigit(static_cast<unsigned char>(c)); };
+    for (size_t i = 0; i < name.size(); ++i) {
+        auto c = name[i];
+        if (is_upper(c) && i > 0) {
+            bool starts_word = is_lower_or_digit(name[i - 1])
+                || (is_upper(name[i - 1]) && i + 1 < name.size() && std::islower(static_cast<unsigned char>(name[i + 1])));
+            if (starts_word)
+                output += '_';
+        }
+        output += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+}
+
+static char closing_delimiter(char opening)
+{
+    return opening == '<' ? '>' : '"';
+}
+
+std::optional<std::string> IncludeRewriter::convert(RuleSet::IncludeRule const& rule, std::string_view argument) const
+{
+    auto name = argument.substr(rule.from.size());
+    auto closing = closing_delimiter(rule.from[0]);
+    auto end = closing == '>' ? name.find(closing) : name.rfind(closing);
+    if (end == std::string_view::npos)
+        return std::nullopt;
+    name = name.substr(0, end);
+
+    std::string line = "#include ";
+    line += rule.to[0];
+    if (rule.under_include_path)
+        line += m_include_path;
+    line += std::string_view { rule.to }.substr(1);
+    switch (rule.casing) {
+    case RuleSet::IncludeCasing::Keep:
+        line += name;
+        break;
+    case RuleSet::IncludeCasing::Lower:
+        std::ranges::transform(name, std::back_inserter(line), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        break;
+    case RuleSet::IncludeCasing::Snake:
+        // Every path component on its own, "LibFoo/DOMParser.h" -> "lib_foo/dom_parser.h".
+        while (true) {
+            auto slash = name.find('/');
+            append_snake_case(line, name.substr(0, slash));
+            if (slash == std::string_view::npos)
+                break;
+            line += '/';
+            name.remove_prefix(slash + 1);
+        }
+        break;
+    }
+    line += rule.suffix;
+    line += closing_delimiter(rule.to[0]);
+    return line;
+}
+
+std::optional<IncludeRewriter::Rewrite> IncludeRewriter::rewrite(std::string_view argument)
+{
+    auto index = longest_root(argument);
+    if (!index)
+        return std::nullopt;
+    auto const& rule = m_rules[*index];
+    Rewrite rewrite { m_rule_names[*index] };
+    if (rule.to.empty())
+        return rewrite;
+
+    std::optional<std::string> const* line = nullptr;
+    {
+        std::shared_lock lock(m_interned_mutex);
+        if (auto it = m_interned.find(argument); it != m_interned.end())
+            line = &it->second;
+    }
+    if (!line) {
+        auto converted = convert(rule, argument);
+        std::unique_lock lock(m_interned_mutex);
+        line = &m_interned.try_emplace(std::string { argument }, std::move(converted)).first->second;
+    }
+    if (*line)
+        rewrite.line = **line;
+    else
+        rewrite.is_unterminated = true;
+    return rewrite;
+}
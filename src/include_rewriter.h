@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "rule_set.h"
+
+// Rewrites #include lines by the include rules of a RuleSet. The rules' roots
+// are stored in a trie, which finds the longest root an #include argument
+// starts with in one pass over it.
+//
+// Rewritten lines are interned: every distinct argument is converted once and
+// the result is reused, by all converters that share the rewriter. That is
+// safe from several threads.
+class IncludeRewriter {
+public:
+    IncludeRewriter(RuleSet const& rules, std::string include_path);
+
+    struct Rewrite {
+        // Name of the matched rule, for the statistics.
+        std::string_view rule;
+        // The whole rewritten line, nullopt if the #include is dropped.
+        std::optional<std::string_view> line {};
+        // Dropped because the argument is not closed.
+        bool is_unterminated { false };
+    };
+    // Rewrites `#include <argument>`, nullopt if no root matches it.
+    std::optional<Rewrite> rewrite(std::string_view argument);
+
+private:
+    struct TrieNode {
+        // Sorted by byte.
+        std::vector<std::pair<char, uint32_t>> children;
+        std::optional<uint32_t> rule;
+    };
+    std::optional<uint32_t> longest_root(std::string_view argument) const;
+    std::optional<std::string> convert(RuleSet::IncludeRule const& rule, std::string_view argument) const;
+
+    std::vector<RuleSet::IncludeRule> m_rules;
+    std::vector<std::string> m_rule_names;
+    std::string m_include_path;
+    std::vector<TrieNode> m_trie;
+
+    std::shared_mutex m_interned_mutex;
+    // Unterminated arguments map to nullopt. References into the map stay
+    // valid when it grows.
+    struct ArgumentHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view argument) const { return std::hash<std::string_view> {}(argument); }
+    };
+    std::unordered_map<std::string, std::optional<std::string>, ArgumentHash, std::equal_to<>> m_interned;
+};
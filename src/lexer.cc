@@ -0,0 +1,237 @@
+#include "lexer.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+
+// Character classes, looked up in a table instead of compared one by one.
+enum CharClass : uint8_t {
+    Space = 1 << 0,
+    IdentifierStart = 1 << 1,
+    Digit = 1 << 2,
+    IdentifierChar = IdentifierStart | Digit,
+};
+
+constexpr auto char_classes = [] {
+    std::array<uint8_t, 256> classes {};
+    for (unsigned char c : std::string_view { " \t\r\f\v" })
+        classes[c] = Space;
+    for (int c = 'a'; c <= 'z'; ++c)
+        classes[c] = IdentifierStart;
+    for (int c = 'A'; c <= 'Z'; ++c)
+        classes[c] = IdentifierStart;
+    classes['_'] = IdentifierStart;
+    for (int c = '0'; c <= '9'; ++c)
+        classes[c] = Digit;
+    return classes;
+}();
+
+bool has_class(char c, uint8_t char_class)
+{
+    return char_classes[static_cast<unsigned char>(c)] & char_class;
+}
+
+bool is_identifier_start(char c)
+{
+    return has_class(c, IdentifierStart);
+}
+
+bool is_identifier_char(char c)
+{
+    return has_class(c, IdentifierChar);
+}
+
+bool is_digit(char c)
+{
+    return has_class(c, Digit);
+}
+
+size_t skip_identifier(std::string_view line, size_t position)
+{
+    while (position < line.size() && is_identifier_char(line[position]))
+        ++position;
+    return position;
+}
+
+bool is_string_prefix(std::string_view identifier)
+{
+    static constexpr std::array<std::string_view, 9> prefixes { "R", "L", "u", "U", "u8", "LR", "uR", "UR", "u8R" };
+    return std::find(prefixes.begin(), prefixes.end(), identifier) != prefixes.end();
+}
+
+// The longest operator at the start of `rest`, e.g. 3 for "<<=" and 1 for ";".
+size_t punctuation_length(std::string_view rest)
+{
+    char next = rest.size() > 1 ? rest[1] : '\0';
+    char third = rest.size() > 2 ? rest[2] : '\0';
+    switch (rest[0]) {
+    case '<':
+        if (next == '<')
+            return third == '=' ? 3 : 2;
+        if (next == '=')
+            return third == '>' ? 3 : 2;
+        return 1;
+    case '>':
+        if (next == '>')
+            return third == '=' ? 3 : 2;
+        return next == '=' ? 2 : 1;
+    case '-':
+        if (next == '>')
+            return third == '*' ? 3 : 2;
+        return next == '-' || next == '=' ? 2 : 1;
+    case '.':
+        if (next == '.' && third == '.')
+            return 3;
+        return next == '*' ? 2 : 1;
+    case ':':
+        return next == ':' ? 2 : 1;
+    case '+':
+        return next == '+' || next == '=' ? 2 : 1;
+    case '&':
+        return next == '&' || next == '=' ? 2 : 1;
+    case '|':
+        return next == '|' || next == '=' ? 2 : 1;
+    case '#':
+        return next == '#' ? 2 : 1;
+    case '=':
+    case '!':
+    case '*':
+    case '/':
+    case '%':
+    case '^':
+        return next == '=' ? 2 : 1;
+    default:
+        return 1;
+    }
+}
+
+// Returns the position one past the closing quote, or the end of the line.
+size_t skip_quoted(std::string_view line, size_t position, char quote)
+{
+    for (++position; position < line.size(); ++position) {
+        if (line[position] == '\\')
+            ++position;
+        else if (line[position] == quote)
+            return position + 1;
+    }
+    return line.size();
+}
+
+size_t skip_raw_string(std::string_view line, size_t position)
+{
+    // position is at the opening quote of R"delimiter( ... )delimiter"
+    auto open_paren = line.find('(', position);
+    if (open_paren == std::string_view::npos)
+        return line.size();
+    auto delimiter = line.substr(position + 1, open_paren - position - 1);
+    for (auto close = line.find(')', open_paren); close != std::string_view::npos; close = line.find(')', close + 1)) {
+        auto rest = line.substr(close + 1);
+        if (rest.starts_with(delimiter) && rest.size() > delimiter.size() && rest[delimiter.size()] == '"')
+            return close + 1 + delimiter.size() + 1;
+    }
+    return line.size();
+}
+
+}
+
+void lex_line(std::string_view line, uint32_t line_number, LexState& state, PackedTokens& tokens)
+{
+    auto emit = [&](size_t start, size_t end, TokenKind kind) {
+        PackedToken token;
+        token.start_line = line_number;
+        token.end_line = line_number;
+        token.start_column = start;
+        token.end_column = std::min<size_t>(end - 1, PackedToken::max_end_column);
+        token.type = static_cast<uint32_t>(kind);
+        tokens.push_back(token);
+    };
+
+    size_t position = 0;
+    if (state == LexState::BlockComment) {
+        auto end = line.find("*/");
+        if (end == std::string_view::npos) {
+            if (!line.empty())
+                emit(0, line.size(), TokenKind::Comment);
+            return;
+        }
+        emit(0, end + 2, TokenKind::Comment);
+        position = end + 2;
+        state = LexState::Code;
+    }
+
+    bool at_line_start = true;
+    while (position < line.size()) {
+        char c = line[position];
+        if (has_class(c, Space)) {
+            ++position;
+            continue;
+        }
+
+        size_t start = position;
+        if (c == '/' && position + 1 < line.size() && line[position + 1] == '/') {
+            emit(start, line.size(), TokenKind::Comment);
+            return;
+        }
+        if (c == '/' && position + 1 < line.size() && line[position + 1] == '*') {
+            auto end = line.find("*/", position + 2);
+            if (end == std::string_view::npos) {
+                emit(start, line.size(), TokenKind::Comment);
+                state = LexState::BlockComment;
+                return;
+            }
+            position = end + 2;
+            emit(start, position, TokenKind::Comment);
+        } else if (c == '#' && at_line_start) {
+            // The directive name, e.g. "#include" or "#  define".
+            ++position;
+            while (position < line.size() && (line[position] == ' ' || line[position] == '\t'))
+                ++position;
+            position = skip_identifier(line, position);
+            emit(start, position, TokenKind::Preprocessor);
+            auto directive = line.substr(start, position - start);
+            if (directive.ends_with("include")) {
+                while (position < line.size() && (line[position] == ' ' || line[position] == '\t'))
+                    ++position;
+                if (position < line.size() && (line[position] == '<' || line[position] == '"')) {
+                    auto end = line.find(line[position] == '<' ? '>' : '"', position + 1);
+                    auto path_start = position;
+                    position = end == std::string_view::npos ? line.size() : end + 1;
+                    emit(path_start, position, TokenKind::String);
+                }
+            }
+        } else if (is_identifier_start(c)) {
+            position = skip_identifier(line, position + 1);
+            if (position < line.size() && (line[position] == '"' || line[position] == '\'') && is_string_prefix(line.substr(start, position - start))) {
+                bool is_raw = line[position - 1] == 'R';
+                char quote = line[position];
+                position = is_raw ? skip_raw_string(line, position) : skip_quoted(line, position, quote);
+                emit(start, position, quote == '"' ? TokenKind::String : TokenKind::Character);
+            } else {
+                emit(start, position, TokenKind::Identifier);
+            }
+        } else if (is_digit(c) || (c == '.' && position + 1 < line.size() && is_digit(line[position + 1]))) {
+            ++position;
+            while (position < line.size()) {
+                char d = line[position];
+                if (is_identifier_char(d) || d == '.' || d == '\'') {
+                    ++position;
+                } else if ((d == '+' || d == '-') && (line[position - 1] == 'e' || line[position - 1] == 'E' || line[position - 1] == 'p' || line[position - 1] == 'P')) {
+                    ++position;
+                } else {
+                    break;
+                }
+            }
+            emit(start, position, TokenKind::Number);
+        } else if (c == '"') {
+            position = skip_quoted(line, position, '"');
+            emit(start, position, TokenKind::String);
+        } else if (c == '\'') {
+            position = skip_quoted(line, position, '\'');
+            emit(start, position, TokenKind::Character);
+        } else {
+            position += punctuation_length(line.substr(position));
+            emit(start, position, TokenKind::Punctuation);
+        }
+        at_line_start = false;
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string_view>
+#include "packed_token.h"
+
+// Lexer state that is carried from one line to the next.
+enum class LexState : uint8_t {
+    Code,
+    BlockComment,
+};
+
+// Appends the tokens of one line (0-based `line_number`) to `tokens`. Only the
+// token boundaries the rewrite rules and the paren matching need are produced:
+// a block comment spanning lines yields one comment token per line and raw
+// string literals end at the end of the line.
+void lex_line(std::string_view line, uint32_t line_number, LexState& state, PackedTokens& tokens);
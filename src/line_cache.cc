@@ -0,0 +1,40 @@
+#include "line_cache.h"
+
+LineCache::LineCache(size_t max_bytes)
+    : m_seen(std::make_unique<std::atomic<uint64_t>[]>(seen_bits / 64))
+    , m_max_bytes(max_bytes)
+{
+}
+
+LineCache::Lookup LineCache::find(std::string_view line)
+{
+    auto hash = LineHash {}(line);
+    // The high bits pick the shard, the map of the shard uses the low ones.
+    auto& shard = m_shards[(hash >> 32) % shard_count];
+    {
+        std::lock_guard lock(shard.mutex);
+        if (auto it = shard.entries.find(line); it != shard.entries.end())
+            return { &it->second };
+    }
+    if (m_bytes.load(std::memory_order_relaxed) >= m_max_bytes)
+        return {};
+    auto bit = hash % seen_bits;
+    auto mask = uint64_t { 1 } << (bit % 64);
+    bool seen = m_seen[bit / 64].fetch_or(mask, std::memory_order_relaxed) & mask;
+    return { nullptr, seen };
+}
+
+void LineCache::insert(std::string_view line, Entry entry)
+{
+    // Roughly what the entry costs, including the map node.
+    auto bytes = 2 * line.size() + sizeof(Entry) + 64;
+    for (auto const& hit : entry.rule_hits)
+        bytes += sizeof(RuleHit) + hit.name.size();
+    if (m_bytes.load(std::memory_order_relaxed) + bytes > m_max_bytes)
+        return;
+
+    auto& shard = m_shards[(LineHash {}(line) >> 32) % shard_count];
+    std::lock_guard lock(shard.mutex);
+    if (shard.entries.try_emplace(std::string { line }, std::move(entry)).second)
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
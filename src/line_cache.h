@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Converted lines shared by the converters of a batch. Only lines whose
+// conversion depends on their text alone are cached: no rule that looks at
+// tokens or declarations matched them. A line that was converted once is
+// then taken from the cache by every converter, without going through the
+// rules. Entries are keyed on the full text of the original line, so lines
+// whose hashes collide never share one.
+//
+// The cache is split into shards by the hash of the line, each behind a mutex
+// of its own, so that workers rarely wait for each other. Most lines of a
+// source tree occur once, so a line is only worth an entry the second time it
+// is looked up: a bit per line hash remembers the first time. Entries are
+// never removed, and once the cache holds `max_bytes` no more are added.
+class LineCache {
+public:
+    struct RuleHit {
+        std::string name;
+        uint32_t replacements { 0 };
+    };
+
+    // What converting the line did.
+    struct Entry {
+        // A rule that looks at tokens matched the line, so it has to be
+        // converted every time and nothing else is recorded.
+        bool depends_on_tokens { false };
+        // Nullopt if the line is dropped from the output.
+        std::optional<std::string> line {};
+        // The headers and declarations the line needs, as ConvertAkToStd
+        // encodes them.
+        uint32_t flags { 0 };
+        bool is_include { false };
+        std::vector<std::string> debug_constants {};
+        std::vector<std::string> extra_includes {};
+        // Only recorded when the converter collects statistics.
+        std::vector<RuleHit> rule_hits {};
+    };
+
+    explicit LineCache(size_t max_bytes);
+
+    struct Lookup {
+        // Valid as long as the cache, null if the line has no entry.
+        Entry const* entry { nullptr };
+        // Whether the caller should insert() the line once it is converted.
+        bool worth_caching { false };
+    };
+    Lookup find(std::string_view line);
+    void insert(std::string_view line, Entry entry);
+
+    size_t size_in_bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+private:
+    struct LineHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view line) const { return std::hash<std::string_view> {}(line); }
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry, LineHash, std::equal_to<>> entries;
+    };
+    static constexpr size_t shard_count = 64;
+
+    static constexpr size_t seen_bits = size_t { 1 } << 20;
+
+    std::array<Shard, shard_count> m_shards;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_seen;
+    size_t m_max_bytes;
+    std::atomic<size_t> m_bytes { 0 };
+};
@@ -0,0 +1,195 @@
+#include "line_prefilter.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <fmt/format.h>
+#if defined(__x86_64__)
+#    include <immintrin.h>
+#endif
+
+// The SSE2 path compares with every distinct byte, with more of them the
+// scalar loop is about as fast.
+static constexpr size_t max_distinct_bytes = 32;
+
+static uint8_t index_of(std::vector<char>& bytes, char byte) {
+    auto it = std::find(bytes.begin(), bytes.end(), byte);
+    if (it != bytes.end())
+        return static_cast<uint8_t>(it - bytes.begin());
+    bytes.push_back(byte);
+    return static_cast<uint8_t>(bytes.size() - 1);
+}
+
+LinePrefilter::LinePrefilter(std::span<std::string_view const> keys) {
+    for (auto key : keys) {
+        if (key.size() != 2)
+            throw std::invalid_argument(fmt::format("prefilter key '{}' is not two bytes long", key));
+        auto pair = std::make_pair(index_of(m_first_bytes, key[0]), index_of(m_second_bytes, key[1]));
+        if (std::find(m_keys.begin(), m_keys.end(), pair) == m_keys.end())
+            m_keys.push_back(pair);
+        auto bits = static_cast<uint8_t>(key[0]) << 8 | static_cast<uint8_t>(key[1]);
+        m_key_bits[bits / 64] |= uint64_t { 1 } << (bits % 64);
+    }
+
+    // Keys with the same first byte share a group, so that the nibbles of
+    // different first bytes mix as little as possible.
+    for (auto [first_index, second_index] : m_keys) {
+        auto group = uint8_t { 1 } << (first_index % 8);
+        auto first = static_cast<uint8_t>(m_first_bytes[first_index]);
+        auto second = static_cast<uint8_t>(m_second_bytes[second_index]);
+        m_first_low_nibble_groups[first & 0xf] |= group;
+        m_first_high_nibble_groups[first >> 4] |= group;
+        m_second_low_nibble_groups[second & 0xf] |= group;
+        m_second_high_nibble_groups[second >> 4] |= group;
+    }
+}
+
+// The lines are counted while scanning, the flags grow with the flagged lines.
+static void flag_line(std::vector<uint8_t>& line_flags, size_t line) {
+    if (line >= line_flags.size())
+        line_flags.resize(line + 1);
+    line_flags[line] = 1;
+}
+
+bool LinePrefilter::supports(Implementation implementation) const {
+    switch (implementation) {
+    case Implementation::Scalar:
+        return true;
+#if defined(__x86_64__)
+    case Implementation::Sse2:
+        return m_first_bytes.size() <= max_distinct_bytes && m_second_bytes.size() <= max_distinct_bytes;
+    case Implementation::Avx2: {
+        static bool const has_avx2 = __builtin_cpu_supports("avx2");
+        return has_avx2;
+    }
+#else
+    case Implementation::Sse2:
+    case Implementation::Avx2:
+        return false;
+#endif
+    }
+    return false;
+}
+
+LinePrefilter::Implementation LinePrefilter::best_implementation() const {
+    for (auto implementation : { Implementation::Avx2, Implementation::Sse2 }) {
+        if (supports(implementation))
+            return implementation;
+    }
+    return Implementation::Scalar;
+}
+
+void LinePrefilter::flag_lines(std::string_view buffer, std::vector<uint8_t>& line_flags, Implementation implementation) const {
+    if (!supports(implementation))
+        throw std::invalid_argument(fmt::format("prefilter implementation {} is not supported", static_cast<int>(implementation)));
+    line_flags.clear();
+    size_t position = 0;
+    size_t line = 0;
+#if defined(__x86_64__)
+    if (implementation == Implementation::Avx2)
+        std::tie(position, line) = flag_lines_avx2(buffer, line_flags);
+    else if (implementation == Implementation::Sse2)
+        std::tie(position, line) = flag_lines_sse2(buffer, line_flags);
+#endif
+    line = flag_lines_scalar(buffer, position, line, line_flags);
+    line_flags.resize(line + (!buffer.empty() && buffer.back() != '\n'));
+}
+
+size_t LinePrefilter::flag_lines_scalar(std::string_view buffer, size_t position, size_t line, std::vector<uint8_t>& line_flags) const {
+    for (; position < buffer.size(); ++position) {
+        if (buffer[position] == '\n')
+            line++;
+        else if (position + 1 < buffer.size() && has_key_at(buffer, position))
+            flag_line(line_flags, line);
+    }
+    return line;
+}
+
+#if defined(__x86_64__)
+
+// Flags the lines of the keys found in one block, given a bit per byte of the
+// block for the key starts and for the newlines. Returns the line the next
+// block starts in.
+static size_t flag_block(uint32_t hits, uint32_t newlines, size_t line, std::vector<uint8_t>& line_flags) {
+    for (; hits; hits &= hits - 1) {
+        auto position = std::countr_zero(hits);
+        flag_line(line_flags, line + std::popcount(newlines & ((uint32_t { 1 } << position) - 1)));
+    }
+    return line + std::popcount(newlines);
+}
+
+// The second bytes of a block are loaded one byte further than the first
+// ones, so the vector loops stop one byte early and leave the rest of the
+// buffer to the scalar loop.
+
+std::pair<size_t, size_t> LinePrefilter::flag_lines_sse2(std::string_view buffer, std::vector<uint8_t>& line_flags) const {
+    __m128i first_bytes[max_distinct_bytes];
+    __m128i second_bytes[max_distinct_bytes];
+    for (size_t i = 0; i < m_first_bytes.size(); ++i)
+        first_bytes[i] = _mm_set1_epi8(m_first_bytes[i]);
+    for (size_t i = 0; i < m_second_bytes.size(); ++i)
+        second_bytes[i] = _mm_set1_epi8(m_second_bytes[i]);
+    auto newline = _mm_set1_epi8('\n');
+
+    std::array<uint32_t, max_distinct_bytes> first;
+    std::array<uint32_t, max_distinct_bytes> second;
+    size_t position = 0;
+    size_t line = 0;
+    for (; position + 17 <= buffer.size(); position += 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(buffer.data() + position));
+        auto next = _mm_loadu_si128(reinterpret_cast<__m128i const*>(buffer.data() + position + 1));
+        for (size_t i = 0; i < m_first_bytes.size(); ++i)
+            first[i] = _mm_movemask_epi8(_mm_cmpeq_epi8(block, first_bytes[i]));
+        for (size_t i = 0; i < m_second_bytes.size(); ++i)
+            second[i] = _mm_movemask_epi8(_mm_cmpeq_epi8(next, second_bytes[i]));
+        uint32_t hits = 0;
+        for (auto [first_index, second_index] : m_keys)
+            hits |= first[first_index] & second[second_index];
+        auto newlines = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        line = flag_block(hits, newlines, line, line_flags);
+    }
+    return { position, line };
+}
+
+__attribute__((target("avx2")))
+static __m256i nibble_table(std::array<uint8_t, 16> const& table) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(table.data())));
+}
+
+// The groups each byte of `block` can be in, by looking up both its nibbles.
+__attribute__((target("avx2")))
+static __m256i groups_of(__m256i block, __m256i low_nibble_groups, __m256i high_nibble_groups) {
+    auto nibble_mask = _mm256_set1_epi8(0xf);
+    auto low = _mm256_and_si256(block, nibble_mask);
+    auto high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble_mask);
+    return _mm256_and_si256(_mm256_shuffle_epi8(low_nibble_groups, low), _mm256_shuffle_epi8(high_nibble_groups, high));
+}
+
+__attribute__((target("avx2")))
+std::pair<size_t, size_t> LinePrefilter::flag_lines_avx2(std::string_view buffer, std::vector<uint8_t>& line_flags) const {
+    auto first_low = nibble_table(m_first_low_nibble_groups);
+    auto first_high = nibble_table(m_first_high_nibble_groups);
+    auto second_low = nibble_table(m_second_low_nibble_groups);
+    auto second_high = nibble_table(m_second_high_nibble_groups);
+    auto newline = _mm256_set1_epi8('\n');
+    auto zero = _mm256_setzero_si256();
+
+    size_t position = 0;
+    size_t line = 0;
+    for (; position + 33 <= buffer.size(); position += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(buffer.data() + position));
+        auto next = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(buffer.data() + position + 1));
+        auto groups = _mm256_and_si256(groups_of(block, first_low, first_high), groups_of(next, second_low, second_high));
+        auto candidates = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(groups, zero)));
+        auto newlines = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+        uint32_t hits = 0;
+        for (; candidates; candidates &= candidates - 1) {
+            auto candidate = std::countr_zero(candidates);
+            if (has_key_at(buffer, position + candidate))
+                hits |= uint32_t { 1 } << candidate;
+        }
+        line = flag_block(hits, newlines, line, line_flags);
+    }
+    return { position, line };
+}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Finds the lines of a buffer that contain any of a set of two byte keys, 16
+// (SSE2) or 32 (AVX2) bytes at a time where the CPU has the instructions. The
+// rewrite rules use it to skip the lines that none of their anchors can match:
+// every anchor contains one of the keys.
+//
+// The SSE2 path compares every byte with each distinct first and second byte
+// of the keys. The AVX2 path looks both bytes up in nibble tables instead,
+// which tell which of eight key groups a byte can belong to, and confirms the
+// candidates against the exact key set. Keys with more than 32 distinct first
+// or second bytes are only searched with AVX2 or the scalar loop.
+class LinePrefilter {
+public:
+    // Throws std::invalid_argument if a key is not two bytes long.
+    explicit LinePrefilter(std::span<std::string_view const> keys);
+
+    enum class Implementation : uint8_t {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+    // Whether the CPU has the instructions of `implementation` and, for SSE2,
+    // the keys are few enough.
+    bool supports(Implementation implementation) const;
+    // The fastest supported implementation, the one flag_lines() uses.
+    Implementation best_implementation() const;
+
+    // Sets line_flags[i] to 1 if line i of `buffer` (as split_into_lines()
+    // splits it) contains a key, and to 0 otherwise.
+    void flag_lines(std::string_view buffer, std::vector<uint8_t>& line_flags) const
+    {
+        flag_lines(buffer, line_flags, best_implementation());
+    }
+    // The same with the given implementation. Throws std::invalid_argument if
+    // it is not supported.
+    void flag_lines(std::string_view buffer, std::vector<uint8_t>& line_flags, Implementation implementation) const;
+
+    bool has_key_at(std::string_view buffer, size_t position) const
+    {
+        auto key = static_cast<uint8_t>(buffer[position]) << 8 | static_cast<uint8_t>(buffer[position + 1]);
+        return m_key_bits[key / 64] & (uint64_t { 1 } << (key % 64));
+    }
+
+private:
+    // Returns the number of newlines up to the end of the buffer.
+    size_t flag_lines_scalar(std::string_view buffer, size_t position, size_t line, std::vector<uint8_t>& line_flags) const;
+#if defined(__x86_64__)
+    std::pair<size_t, size_t> flag_lines_sse2(std::string_view buffer, std::vector<uint8_t>& line_flags) const;
+    std::pair<size_t, size_t> flag_lines_avx2(std::string_view buffer, std::vector<uint8_t>& line_flags) const;
+#endif
+
+    // Distinct bytes the keys start and end with, and every key as a pair of
+    // indices into them.
+    std::vector<char> m_first_bytes;
+    std::vector<char> m_second_bytes;
+    std::vector<std::pair<uint8_t, uint8_t>> m_keys;
+    // One bit per possible two byte sequence, for the scalar path and to
+    // confirm the candidates of the AVX2 path.
+    std::array<uint64_t, 65536 / 64> m_key_bits {};
+    // For the first and the second byte of the keys: the groups a byte can be
+    // in, by its low and by its high nibble.
+    std::array<uint8_t, 16> m_first_low_nibble_groups {};
+    std::array<uint8_t, 16> m_first_high_nibble_groups {};
+    std::array<uint8_t, 16> m_second_low_nibble_groups {};
+    std::array<uint8_t, 16> m_second_high_nibble_groups {};
+};
@@ -1,14 +1,36 @@
 #pragma once
 #include <filesystem>
+#include <functional>
+#include <unordered_map>
 #include "filedb.hh"
 
 class LocalFileDB : public CodeComprehension::FileDB {
 public:
     LocalFileDB() = default;
 
+    using Loader = std::function<std::optional<std::string>(std::string const&)>;
+
     void add(std::string filename, std::string content)
     {
-        m_map.emplace(filename, content);
+        m_map.insert_or_assign(filename, content);
+    }
+
+    void remove(std::string const& filename)
+    {
+        m_map.erase(filename);
+    }
+
+    // Consulted for files that are not (or no longer) in the map.
+    void set_loader(Loader loader)
+    {
+        m_loader = std::move(loader);
+    }
+
+    // Called with every file the engine reads, e.g. to record the files a query depended on.
+    using ReadObserver = std::function<void(std::string const&, std::string const&)>;
+    void set_read_observer(ReadObserver observer)
+    {
+        m_read_observer = std::move(observer);
     }
 
     virtual std::optional<std::string> get_or_read_from_filesystem(std::string_view filename) const override
@@ -20,31 +42,22 @@ public:
         }
 
         auto result = m_map.find(target_filename);
-        if(result == m_map.end())
-            return std::nullopt;
+        if(result == m_map.end()) {
+            if (!m_loader)
+                return std::nullopt;
+            auto content = m_loader(target_filename);
+            if (content && m_read_observer)
+                m_read_observer(target_filename, *content);
+            return content;
+        }
 
+        if (m_read_observer)
+            m_read_observer(target_filename, result->second);
         return result->second;
     }
 
 private:
     std::unordered_map<std::string, std::string> m_map;
+    Loader m_loader;
+    ReadObserver m_read_observer;
 };
-
-std::string TESTS_ROOT_DIR = "";
-
-static void add_file(LocalFileDB& filedb, std::string const& name)
-{
-    std::filesystem::path root_dir_path{TESTS_ROOT_DIR};
-    std::filesystem::path name_path{name};
-    auto final_path = root_dir_path / name_path;
-    std::ifstream file(final_path);
-    if(!file)  {
-        dbgln("Unable to load {}", final_path.c_str());
-        throw std::runtime_error("unable to load file");
-    }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-    auto file_content = buffer.str();
-    filedb.add(name, file_content);
-}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// What lex_line() found.
+enum class TokenKind : uint8_t {
+    Unknown,
+    Identifier,
+    Number,
+    String,
+    Character,
+    Comment,
+    Punctuation,
+    Preprocessor,
+};
+
+// A token in 16 instead of the 40 bytes of the engine's TokenInfo, so that a
+// file's token vector is a compact array that the linear token scans stream
+// through.
+struct PackedToken {
+    static constexpr uint32_t max_end_column = (1u << 24) - 1;
+
+    uint32_t start_line;
+    uint32_t end_line;
+    uint32_t start_column;
+    uint32_t end_column : 24;
+    uint32_t type : 8;
+};
+static_assert(sizeof(PackedToken) == 16);
+
+using PackedTokens = std::vector<PackedToken>;
@@ -0,0 +1,77 @@
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::string_view hardware_counter_name(HardwareCounter counter) {
+    switch (counter) {
+    case HardwareCounter::Cycles: return "cycles";
+    case HardwareCounter::Instructions: return "instructions";
+    case HardwareCounter::CacheMisses: return "cache-misses";
+    case HardwareCounter::BranchMisses: return "branch-misses";
+    }
+    return "unknown";
+}
+
+static int open_counter(uint64_t config, int group_fd)
+{
+    perf_event_attr attributes {};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = config;
+    attributes.read_format = PERF_FORMAT_GROUP;
+    attributes.disabled = group_fd < 0;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+PerfCounters::PerfCounters()
+{
+    static constexpr std::array<uint64_t, hardware_counter_count> configs {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    m_fds.fill(-1);
+    m_fds[0] = open_counter(configs[0], -1);
+    if (m_fds[0] < 0)
+        throw std::runtime_error(fmt::format("perf_event_open: {}", strerror(errno)));
+    for (size_t i = 1; i < hardware_counter_count; ++i)
+        m_fds[i] = open_counter(configs[i], m_fds[0]);
+
+    ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (auto fd : m_fds) {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+HardwareCounterValues PerfCounters::read() const
+{
+    // PERF_FORMAT_GROUP: the number of counters, then one value per opened
+    // counter in the order they joined the group.
+    std::array<uint64_t, 1 + hardware_counter_count> buffer {};
+    HardwareCounterValues values {};
+    if (::read(m_fds[0], buffer.data(), sizeof(buffer)) < 0)
+        return values;
+
+    size_t next_value = 1;
+    for (size_t i = 0; i < hardware_counter_count && next_value <= buffer[0]; ++i) {
+        if (m_fds[i] >= 0)
+            values[i] = buffer[next_value++];
+    }
+    return values;
+}
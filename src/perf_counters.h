@@ -0,0 +1,36 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+enum class HardwareCounter : uint8_t {
+    Cycles,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+};
+inline constexpr size_t hardware_counter_count = 4;
+std::string_view hardware_counter_name(HardwareCounter counter);
+
+using HardwareCounterValues = std::array<uint64_t, hardware_counter_count>;
+
+// Hardware counters of the calling thread (user space only), read as one
+// group through Linux perf_event_open. Counters the CPU or the hypervisor
+// doesn't provide stay at zero, see is_available().
+class PerfCounters {
+public:
+    // Throws std::runtime_error if not even the cycle counter can be opened,
+    // e.g. because of kernel.perf_event_paranoid.
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+
+    bool is_available(HardwareCounter counter) const { return m_fds[static_cast<size_t>(counter)] >= 0; }
+    // Counts since construction. Only meaningful on the constructing thread.
+    HardwareCounterValues read() const;
+
+private:
+    std::array<int, hardware_counter_count> m_fds;
+};
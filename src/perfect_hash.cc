@@ -0,0 +1,58 @@
+#include "perfect_hash.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <fmt/format.h>
+
+PerfectHash::PerfectHash(std::vector<std::string> keys)
+    : m_keys(std::move(keys))
+{
+    if (m_keys.empty())
+        return;
+    for (auto const& key : m_keys) {
+        if (key.empty())
+            throw std::invalid_argument("empty perfect hash key");
+    }
+    std::vector<std::string_view> sorted_keys(m_keys.begin(), m_keys.end());
+    std::ranges::sort(sorted_keys);
+    if (auto duplicate = std::ranges::adjacent_find(sorted_keys); duplicate != sorted_keys.end())
+        throw std::invalid_argument(fmt::format("perfect hash key '{}' is given twice", *duplicate));
+
+    // At most half of the slots are used, so a seed for a bucket of a few keys
+    // is found after a handful of tries.
+    m_slots.assign(std::bit_ceil(m_keys.size() * 2), 0);
+    m_seeds.assign(std::bit_ceil((m_keys.size() + 1) / 2), 0);
+    std::vector<std::vector<uint32_t>> buckets(m_seeds.size());
+    for (uint32_t i = 0; i < m_keys.size(); ++i)
+        buckets[bucket_of(hash_of(m_keys[i]))].push_back(i);
+
+    // The largest buckets are placed first, while most slots are still free.
+    std::vector<uint32_t> bucket_order(buckets.size());
+    for (uint32_t i = 0; i < bucket_order.size(); ++i)
+        bucket_order[i] = i;
+    std::ranges::stable_sort(bucket_order, std::greater {}, [&](uint32_t bucket) { return buckets[bucket].size(); });
+
+    std::vector<size_t> placed;
+    for (auto bucket : bucket_order) {
+        if (buckets[bucket].empty())
+            break;
+        for (uint32_t seed = 0;; ++seed) {
+            if (seed == (1u << 24))
+                throw std::logic_error("no perfect hash seed for these keys");
+            placed.clear();
+            for (auto key : buckets[bucket]) {
+                auto slot = slot_of(hash_of(m_keys[key]), seed);
+                if (m_slots[slot] != 0)
+                    break;
+                m_slots[slot] = key + 1;
+                placed.push_back(slot);
+            }
+            if (placed.size() == buckets[bucket].size()) {
+                m_seeds[bucket] = seed;
+                break;
+            }
+            for (auto slot : placed)
+                m_slots[slot] = 0;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A hash table over a set of strings that is fixed once it is built, with no
+// two keys in the same slot. The keys are hashed into buckets, and every
+// bucket gets a seed that moves its keys to slots of their own (hash and
+// displace). A lookup hashes the key once and compares it with the one key in
+// its slot.
+class PerfectHash {
+public:
+    PerfectHash() = default;
+    // Throws std::invalid_argument if a key is empty or given twice.
+    explicit PerfectHash(std::vector<std::string> keys);
+
+    // Index of `key` in the keys the table was built from.
+    std::optional<size_t> find(std::string_view key) const
+    {
+        if (m_slots.empty())
+            return std::nullopt;
+        auto hash = hash_of(key);
+        auto slot = m_slots[slot_of(hash, m_seeds[bucket_of(hash)])];
+        if (slot == 0 || m_keys[slot - 1] != key)
+            return std::nullopt;
+        return slot - 1;
+    }
+
+    size_t size() const { return m_keys.size(); }
+
+private:
+    static uint64_t hash_of(std::string_view key)
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (auto c : key)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+        // FNV-1a barely changes the high bits for keys that differ in their
+        // last bytes, like "key1" and "key2", and the bucket is taken from
+        // them: mix every bit into every other one.
+        hash = (hash ^ hash >> 33) * 0xff51afd7ed558ccd;
+        return hash ^ hash >> 33;
+    }
+    size_t bucket_of(uint64_t hash) const { return (hash >> 32) & (m_seeds.size() - 1); }
+    size_t slot_of(uint64_t hash, uint32_t seed) const
+    {
+        auto mixed = (hash ^ seed) * 0x9e3779b97f4a7c15;
+        return (mixed ^ mixed >> 29) & (m_slots.size() - 1);
+    }
+
+    std::vector<std::string> m_keys;
+    std::vector<uint32_t> m_seeds;
+    // Index + 1 of the key in each slot, 0 for an empty slot.
+    std::vector<uint32_t> m_slots;
+};
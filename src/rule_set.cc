@@ -0,0 +1,255 @@
+#include "rule_set.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <fmt/format.h>
+
+// Keyed by RuleSet::CodeRule. Lines that contain none of the keys and none of
+// the keys of the table driven rules are copied through without going through
+// the rules.
+static constexpr std::array<RuleSet::CodeRuleAnchor, static_cast<size_t>(RuleSet::CodeRule::Count)> code_rule_anchors { {
+    { "#include", "#i", false },
+    { "ByteString::empty()", "St", false },
+    { "ByteString::join", "St", false },
+    { "StringBuilder ", "St", false },
+    { "String(", "St", false },
+    { "VERIFY(", "VE", false },
+    { " move(", "ov", false },
+    { "(move(", "ov", false },
+    { "append(", "pp", true },
+    { "ptr()", "r(", false },
+    { "to_byte_string()", "_b", true },
+    { "is_empty()", "_e", false },
+    { "verify_cast", "y_", false },
+    { "ScopeLogger", "Sc", false },
+    { "extend", "xt", true },
+    { "appendff", "pp", true },
+    { "empend", "mp", false },
+    { "ByteString::formatted", "St", false },
+    { "type_as_byte_string", "_b", false },
+    { "String ", "St", true },
+    { "AK_MAKE_NONCOPYABLE", "AK", true },
+    { "adopt_ref", "_r", true },
+    { " forward<", "d<", false },
+    { "first()", "rs", true },
+    { "\"sv", "\"s", false },
+    { "#include <LibCodeComprehension/Types.h>", "#i", false },
+} };
+static_assert(std::ranges::all_of(code_rule_anchors, [](auto const& anchor) {
+    return anchor.anchor.find(anchor.key) != std::string_view::npos;
+}));
+
+RuleSet::RuleSet()
+{
+    using enum IdentifierPass;
+    m_identifiers = {
+        { "Vector", "std::vector", "<vector>", Types },
+        { "StringView", "std::string_view", "<string_view>", Types },
+        { "DeprecatedFlyString", "std::string", "<string>", Types },
+        { "RefCounted", "intrusive_ref_counter", "\"intrusive_ptr.hh\"", Types },
+        { "NonnullRefPtr", "intrusive_ptr", "\"intrusive_ptr.hh\"", Types },
+        { "RefPtr", "intrusive_ptr", "\"intrusive_ptr.hh\"", Types },
+        { "Optional", "std::optional", "<optional>", Types },
+        { "ByteString", "std::string", "<string>", ByteString },
+        { "CPP_DEBUG", {}, {}, Types, true },
+    };
+    for (auto const& rule : m_identifiers)
+        m_identifier_names.insert(rule.identifier);
+    m_includes = {
+        { "<AK" },
+        { "<LibCpp/", "\"", IncludeCasing::Lower, "h", true },
+        { "\"", "\"", IncludeCasing::Lower, "h", true },
+    };
+    compile();
+}
+
+std::span<RuleSet::CodeRuleAnchor const> RuleSet::code_rules()
+{
+    return code_rule_anchors;
+}
+
+RuleSet const& RuleSet::built_in()
+{
+    static RuleSet const rules;
+    return rules;
+}
+
+static bool is_identifier(std::string_view text)
+{
+    return !text.empty() && !std::isdigit(static_cast<unsigned char>(text[0])) && std::ranges::all_of(text, [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    });
+}
+
+static bool is_header(std::string_view text)
+{
+    return text.size() > 2 && ((text.front() == '<' && text.back() == '>') || (text.front() == '"' && text.back() == '"'));
+}
+
+// Splits a rule line into its fields, up to the first #, and resolves the
+// escapes in them.
+static std::vector<std::string> split_fields(std::string_view line)
+{
+    std::vector<std::string> fields;
+    size_t position = 0;
+    while (true) {
+        while (position < line.size() && std::isspace(static_cast<unsigned char>(line[position])))
+            ++position;
+        if (position == line.size() || line[position] == '#')
+            return fields;
+
+        auto& field = fields.emplace_back();
+        for (; position < line.size() && !std::isspace(static_cast<unsigned char>(line[position])) && line[position] != '#'; ++position) {
+            if (line[position] != '\\') {
+                field += line[position];
+                continue;
+            }
+            if (++position == line.size())
+                throw std::invalid_argument("\\ at the end of the line");
+            switch (line[position]) {
+            case 's': field += ' '; break;
+            case 't': field += '\t'; break;
+            case '#': field += '#'; break;
+            case '\\': field += '\\'; break;
+            default: throw std::invalid_argument(fmt::format("unknown escape \\{}", line[position]));
+            }
+        }
+    }
+}
+
+void RuleSet::add_rules(std::string_view text, std::string_view origin)
+{
+    size_t line_number = 0;
+    while (!text.empty()) {
+        auto end = text.find('\n');
+        auto line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view {} : text.substr(end + 1);
+        ++line_number;
+
+        try {
+            auto fields = split_fields(line);
+            if (fields.empty())
+                continue;
+            auto const& kind = fields[0];
+            auto expect_fields = [&](size_t min, size_t max) {
+                if (fields.size() < min + 1 || fields.size() > max + 1)
+                    throw std::invalid_argument(fmt::format("{} rules take {} to {} arguments", kind, min, max));
+            };
+            auto header = [&](size_t index) {
+                if (fields.size() <= index)
+                    return std::string {};
+                if (!is_header(fields[index]))
+                    throw std::invalid_argument(fmt::format("'{}' is not a header like <name> or \"name\"", fields[index]));
+                return fields[index];
+            };
+
+            if (kind == "identifier") {
+                expect_fields(2, 3);
+                if (!is_identifier(fields[1]) || fields[1].size() < 2)
+                    throw std::invalid_argument(fmt::format("'{}' is not an identifier of two or more characters", fields[1]));
+                add_identifier({ fields[1], fields[2], header(3) });
+            } else if (kind == "literal") {
+                expect_fields(2, 3);
+                if (fields[1].size() < 2)
+                    throw std::invalid_argument("literals need two or more characters");
+                m_literals.push_back({ fields[1], fields[2], header(3) });
+            } else if (kind == "include" || kind == "drop-include") {
+                if (kind == "include")
+                    expect_fields(2, 4);
+                else
+                    expect_fields(1, 1);
+                for (size_t i = 1; i < std::min<size_t>(fields.size(), 3); ++i) {
+                    if (fields[i].empty() || (fields[i][0] != '<' && fields[i][0] != '"'))
+                        throw std::invalid_argument(fmt::format("'{}' does not start an include argument", fields[i]));
+                }
+                if (std::ranges::find(m_includes, fields[1], &IncludeRule::from) != m_includes.end())
+                    throw std::invalid_argument(fmt::format("'{}' already has a rule", fields[1]));
+                IncludeRule rule { fields[1] };
+                if (fields.size() > 2)
+                    rule.to = fields[2];
+                if (fields.size() > 3) {
+                    if (fields[3] == "lower")
+                        rule.casing = IncludeCasing::Lower;
+                    else if (fields[3] == "snake")
+                        rule.casing = IncludeCasing::Snake;
+                    else if (fields[3] != "keep")
+                        throw std::invalid_argument(fmt::format("unknown casing '{}', expected keep, lower or snake", fields[3]));
+                }
+                if (fields.size() > 4)
+                    rule.suffix = fields[4];
+                m_includes.push_back(std::move(rule));
+            } else if (kind == "debug") {
+                expect_fields(1, 1);
+                auto const& name = fields[1];
+                if (name.starts_with('*') && is_identifier(name.substr(1)) && name.size() > 2)
+                    m_debug_suffixes.push_back(name.substr(1));
+                else if (is_identifier(name) && name.size() >= 2)
+                    add_identifier({ name, {}, {}, IdentifierPass::Types, true });
+                else
+                    throw std::invalid_argument(fmt::format("'{}' is neither an identifier nor *<suffix>", name));
+            } else {
+                throw std::invalid_argument(fmt::format("unknown rule kind '{}'", kind));
+            }
+        } catch (std::invalid_argument const& e) {
+            throw std::runtime_error(fmt::format("{}:{}: {}", origin, line_number, e.what()));
+        }
+    }
+    compile();
+}
+
+void RuleSet::add_identifier(IdentifierRule rule)
+{
+    if (!m_identifier_names.insert(rule.identifier).second)
+        throw std::invalid_argument(fmt::format("'{}' already has a rule", rule.identifier));
+    m_identifiers.push_back(std::move(rule));
+}
+
+bool RuleSet::is_debug_constant(std::string_view identifier) const
+{
+    return std::ranges::any_of(m_debug_suffixes, [&](auto const& suffix) {
+        return identifier.size() > suffix.size() && identifier.ends_with(suffix);
+    });
+}
+
+RuleSet::LiteralRule const* RuleSet::longest_literal_at(std::string_view line, size_t position, uint16_t key) const
+{
+    auto [begin, end] = std::ranges::equal_range(m_literals_by_key, key, {}, &std::pair<uint16_t, uint32_t>::first);
+    for (auto it = begin; it != end; ++it) {
+        auto const& rule = m_literals[it->second];
+        if (line.substr(position).starts_with(rule.text))
+            return &rule;
+    }
+    return nullptr;
+}
+
+void RuleSet::compile()
+{
+    std::vector<std::string> identifiers;
+    for (auto const& rule : m_identifiers)
+        identifiers.push_back(rule.identifier);
+    m_identifier_table = PerfectHash { std::move(identifiers) };
+
+    m_literals_by_key.clear();
+    m_literal_key_bits = {};
+    for (uint32_t i = 0; i < m_literals.size(); ++i) {
+        auto key = key_of(m_literals[i].text);
+        m_literals_by_key.emplace_back(key, i);
+        m_literal_key_bits[key / 64] |= uint64_t { 1 } << (key % 64);
+    }
+    std::ranges::stable_sort(m_literals_by_key, [&](auto const& a, auto const& b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        return m_literals[a.second].text.size() > m_literals[b.second].text.size();
+    });
+
+    std::vector<std::string_view> keys;
+    for (auto const& anchor : code_rule_anchors)
+        keys.push_back(anchor.key);
+    for (auto const& rule : m_identifiers)
+        keys.push_back(std::string_view { rule.identifier }.substr(0, 2));
+    for (auto const& suffix : m_debug_suffixes)
+        keys.push_back(std::string_view { suffix }.substr(0, 2));
+    for (auto const& rule : m_literals)
+        keys.push_back(std::string_view { rule.text }.substr(0, 2));
+    m_prefilter.emplace(keys);
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "line_prefilter.h"
+#include "perfect_hash.h"
+
+// The rewrite rules that are data rather than code: identifiers that are
+// renamed as a whole, debug constants, literal rewrites and include roots.
+// Besides the built-in rules it takes rules from rule files, which are
+// compiled into the same tables as the built-in ones, so that they cost no
+// more per line:
+//
+//   - every identifier of a line is looked up once in a perfect hash of all
+//     identifier rules and debug constants,
+//   - literals are found in one pass over the line, starting at the positions
+//     whose two bytes begin a literal,
+//   - the line prefilter is built from the keys of the code rules and of all
+//     rules of the set.
+//
+// A rule file has one rule per line, # starts a comment. Fields are separated
+// by whitespace, \s, \t, \# and \\ stand for a space, a tab, # and \:
+//
+//   identifier <name> <replacement> [<header>]
+//   literal <text> <replacement> [<header>]
+//   include <from> <to> [keep|lower|snake] [<suffix>]
+//   drop-include <from>
+//   debug <name>
+//
+// Headers are written as they appear in an #include, e.g. <vector> or
+// "core/eventloop.h". An include rule replaces the root an #include argument
+// starts with, delimiter included, and converts the rest of the path with the
+// casing policy: `include <LibCore/ "core/ snake` turns
+// `#include <LibCore/EventLoop.h>` into `#include "core/event_loop.h"`. Of
+// several roots the longest one that matches is used, and a root can only have
+// one rule. A debug constant is declared as false if a file uses it,
+// `debug *_DEBUG` declares every identifier that ends in _DEBUG.
+class RuleSet {
+public:
+    // AK types that are renamed where they are a whole identifier. ByteString
+    // is renamed after the rules for its static members (ByteString::join etc.).
+    enum class IdentifierPass : uint8_t {
+        Types,
+        ByteString,
+    };
+
+    struct IdentifierRule {
+        std::string identifier;
+        std::string replacement;
+        // The include the replacement needs, empty for none.
+        std::string header;
+        IdentifierPass pass { IdentifierPass::Types };
+        // Debug constants are not renamed but declared.
+        bool is_debug_constant { false };
+    };
+
+    struct LiteralRule {
+        std::string text;
+        std::string replacement;
+        std::string header;
+    };
+
+    // How an include rule converts the path after the root.
+    enum class IncludeCasing : uint8_t {
+        Keep,
+        Lower,
+        // CamelCase path components become snake_case.
+        Snake,
+    };
+
+    struct IncludeRule {
+        std::string from;
+        // Opening delimiter and path the root is replaced with, empty to drop
+        // the #include.
+        std::string to {};
+        IncludeCasing casing { IncludeCasing::Keep };
+        // Appended to the converted path, e.g. "h" to turn .h into .hh.
+        std::string suffix {};
+        // Whether the converter's include path goes between the delimiter and
+        // the path of `to`.
+        bool under_include_path { false };
+    };
+
+    // The rules that convert_line() implements in code.
+    enum class CodeRule : uint8_t {
+        Include,
+        ByteStringEmpty,
+        ByteStringJoin,
+        StringBuilderDeclaration,
+        StringCall,
+        Verify,
+        Move,
+        ParenthesizedMove,
+        Append,
+        Ptr,
+        ToByteString,
+        IsEmpty,
+        VerifyCast,
+        ScopeLogger,
+        Extend,
+        Appendff,
+        Empend,
+        ByteStringFormatted,
+        TypeAsByteString,
+        StringDeclaration,
+        MakeNoncopyable,
+        AdoptRef,
+        Forward,
+        First,
+        StringViewLiteral,
+        CodeComprehensionTypesInclude,
+        Count,
+    };
+    struct CodeRuleAnchor {
+        // The text the rule looks for in a line, also its name in the stats.
+        std::string_view anchor;
+        // Two bytes out of the anchor for the line prefilter.
+        std::string_view key;
+        // Whether the rule looks at tokens or declarations. Rewrites never
+        // produce the anchor of such a rule from text that had none.
+        bool needs_tokens { false };
+    };
+    // Every code rule, indexed by CodeRule.
+    static std::span<CodeRuleAnchor const> code_rules();
+    static CodeRuleAnchor const& code_rule(CodeRule rule) { return code_rules()[static_cast<size_t>(rule)]; }
+
+    // The built-in rules.
+    RuleSet();
+    static RuleSet const& built_in();
+
+    // Adds the rules of a rule file, `origin` names it in errors. Throws
+    // std::runtime_error for a malformed rule, and if a rule names an
+    // identifier that already has one.
+    void add_rules(std::string_view text, std::string_view origin);
+
+    IdentifierRule const* find_identifier(std::string_view identifier) const
+    {
+        auto index = m_identifier_table.find(identifier);
+        return index ? &m_identifiers[*index] : nullptr;
+    }
+    // Whether `identifier` matches a `debug *<suffix>` rule.
+    bool is_debug_constant(std::string_view identifier) const;
+
+    // Calls on_match(position, rule) for the literal rules that match in
+    // `line`, left to right and without overlaps. Of several literals that
+    // start at the same position the longest one matches.
+    template<typename Callback>
+    void for_each_literal(std::string_view line, Callback on_match) const
+    {
+        if (m_literals.empty())
+            return;
+        size_t position = 0;
+        while (position + 1 < line.size()) {
+            auto key = key_of(line.substr(position));
+            if (!(m_literal_key_bits[key / 64] & (uint64_t { 1 } << (key % 64)))) {
+                ++position;
+                continue;
+            }
+            auto const* rule = longest_literal_at(line, position, key);
+            if (!rule) {
+                ++position;
+                continue;
+            }
+            on_match(position, *rule);
+            position += rule->text.size();
+        }
+    }
+
+    std::vector<IncludeRule> const& include_rules() const { return m_includes; }
+
+    // Flags the lines that a rule of this set or of convert_line() could change.
+    LinePrefilter const& prefilter() const { return *m_prefilter; }
+
+private:
+    static uint16_t key_of(std::string_view text)
+    {
+        return static_cast<uint16_t>(static_cast<uint8_t>(text[0]) << 8 | static_cast<uint8_t>(text[1]));
+    }
+    LiteralRule const* longest_literal_at(std::string_view line, size_t position, uint16_t key) const;
+    void add_identifier(IdentifierRule rule);
+    void compile();
+
+    std::vector<IdentifierRule> m_identifiers;
+    std::unordered_set<std::string> m_identifier_names;
+    PerfectHash m_identifier_table;
+    std::vector<std::string> m_debug_suffixes;
+
+    std::vector<LiteralRule> m_literals;
+    // Literal indices by the two bytes the literal starts with, longest first.
+    std::vector<std::pair<uint16_t, uint32_t>> m_literals_by_key;
+    std::array<uint64_t, 65536 / 64> m_literal_key_bits {};
+
+    std::vector<IncludeRule> m_includes;
+    std::optional<LinePrefilter> m_prefilter;
+};
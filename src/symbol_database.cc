@@ -0,0 +1,665 @@
+#include "symbol_database.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lexer.h"
+
+// The file is a Header followed by the arrays it counts, in this order:
+// MemberEntry[member_count], uint32_t[member_slot_count],
+// ClassEntry[class_count], uint32_t[class_slot_count], StringRef[base_count]
+// and string_bytes of string data. A slot holds the index + 1 of an entry, 0
+// if it is empty, and collisions go to the next slot.
+struct SymbolDatabase::Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t member_count;
+    uint32_t member_slot_count;
+    uint32_t class_count;
+    uint32_t class_slot_count;
+    uint32_t base_count;
+    uint32_t string_bytes;
+};
+
+struct SymbolDatabase::StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SymbolDatabase::MemberEntry {
+    StringRef class_name;
+    StringRef name;
+    StringRef type;
+    MemberKind kind;
+};
+
+struct SymbolDatabase::ClassEntry {
+    StringRef name;
+    uint32_t first_base;
+    uint32_t base_count;
+};
+
+namespace {
+
+constexpr std::array<char, 8> database_magic { 'A', 'K', 'S', 'Y', 'M', 'D', 'B', '\0' };
+constexpr uint32_t database_version = 1;
+// Bases are followed this deep, which also ends cycles.
+constexpr int max_base_depth = 8;
+
+uint64_t hash_of(std::string_view class_name, std::string_view member = {})
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    auto add = [&](std::string_view text) {
+        for (auto c : text)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+    };
+    add(class_name);
+    if (!member.empty()) {
+        hash = (hash ^ ':') * 0x100000001b3;
+        add(member);
+    }
+    return hash;
+}
+
+// A power of two with room for `count` entries at a load of at most one half.
+uint32_t slot_count_for(size_t count)
+{
+    return std::bit_ceil(std::max<uint32_t>(2 * count, 2));
+}
+
+bool is_identifier(std::string_view token)
+{
+    return !token.empty() && (std::isalpha(static_cast<unsigned char>(token[0])) || token[0] == '_');
+}
+
+bool is_macro_name(std::string_view token)
+{
+    return token.size() > 1 && is_identifier(token) && std::ranges::none_of(token, [](char c) { return std::islower(static_cast<unsigned char>(c)); });
+}
+
+bool is_specifier(std::string_view token)
+{
+    static constexpr std::array<std::string_view, 14> specifiers {
+        "virtual", "static", "inline", "constexpr", "consteval", "constinit", "explicit",
+        "mutable", "extern", "thread_local", "ALWAYS_INLINE", "NEVER_INLINE", "FLATTEN", "AK_EXPORT"
+    };
+    return std::ranges::find(specifiers, token) != specifiers.end();
+}
+
+// Tokens joined back into a type, with a space only where one is needed:
+// "Vector<String> const&", "unsigned int".
+std::string join_type(std::span<std::string_view const> tokens)
+{
+    std::string type;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i > 0 && is_identifier(tokens[i])) {
+            auto previous = tokens[i - 1];
+            if (is_identifier(previous) || previous == ">" || previous == ">>" || previous == "*" || previous == "&" || previous == "&&" || previous == ",")
+                type += ' ';
+        }
+        type += tokens[i];
+    }
+    return type;
+}
+
+// How a token changes the nesting of template arguments, parentheses and braces.
+int nesting_change(std::string_view token)
+{
+    if (token == "<" || token == "(" || token == "{" || token == "[")
+        return 1;
+    if (token == ">" || token == ")" || token == "}" || token == "]")
+        return -1;
+    if (token == ">>")
+        return -2;
+    return 0;
+}
+
+bool is_name_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && text.front() == ' ')
+        text.remove_prefix(1);
+    while (!text.empty() && text.back() == ' ')
+        text.remove_suffix(1);
+    return text;
+}
+
+}
+
+ParsedType ParsedType::parse(std::string_view type)
+{
+    ParsedType parsed;
+    size_t position = 0;
+    // The name, the last part of a qualified name after any cv-qualifiers.
+    while (position < type.size()) {
+        if (!is_name_char(type[position])) {
+            if (type[position] == '<' || type[position] == '*' || type[position] == '&')
+                break;
+            ++position;
+            continue;
+        }
+        auto end = position;
+        while (end < type.size() && is_name_char(type[end]))
+            ++end;
+        auto word = type.substr(position, end - position);
+        position = end;
+        if (word == "const" || word == "volatile" || word == "typename" || word == "struct" || word == "class")
+            continue;
+        parsed.name = word;
+        while (position < type.size() && type[position] == ' ')
+            ++position;
+        if (!type.substr(position).starts_with("::"))
+            break;
+        position += 2;
+    }
+
+    // The template arguments, split at the commas that are not nested.
+    if (position < type.size() && type[position] == '<') {
+        int depth = 0;
+        size_t argument_start = position + 1;
+        for (; position < type.size(); ++position) {
+            auto c = type[position];
+            if (c == '<' || c == '(') {
+                ++depth;
+            } else if (c == '>' || c == ')') {
+                if (--depth == 0) {
+                    parsed.arguments.emplace_back(trim(type.substr(argument_start, position - argument_start)));
+                    ++position;
+                    break;
+                }
+            } else if (c == ',' && depth == 1) {
+                parsed.arguments.emplace_back(trim(type.substr(argument_start, position - argument_start)));
+                argument_start = position + 1;
+            }
+        }
+    }
+    parsed.is_pointer = type.find('*', position) != std::string_view::npos;
+    return parsed;
+}
+
+std::string ParsedType::value_type() const
+{
+    std::string type = name;
+    if (!arguments.empty()) {
+        type += '<';
+        for (size_t i = 0; i < arguments.size(); ++i) {
+            if (i > 0)
+                type += ", ";
+            type += arguments[i];
+        }
+        type += '>';
+    }
+    return type;
+}
+
+void SymbolDatabase::Builder::add_source(std::string_view path, std::string_view content)
+{
+    // Lex the file, leaving out comments and preprocessor lines.
+    std::vector<std::string_view> lines;
+    for (size_t start = 0; start <= content.size();) {
+        auto end = content.find('\n', start);
+        if (end == std::string_view::npos)
+            end = content.size();
+        lines.push_back(content.substr(start, end - start));
+        start = end + 1;
+    }
+    PackedTokens tokens;
+    PackedTokens code;
+    LexState lex_state = LexState::Code;
+    for (uint32_t row = 0; row < lines.size(); ++row) {
+        tokens.clear();
+        lex_line(lines[row], row, lex_state, tokens);
+        if (!tokens.empty() && static_cast<TokenKind>(tokens[0].type) == TokenKind::Preprocessor)
+            continue;
+        for (auto const& token : tokens) {
+            if (static_cast<TokenKind>(token.type) != TokenKind::Comment)
+                code.push_back(token);
+        }
+    }
+    auto text = [&](size_t index) -> std::string_view {
+        auto const& token = code[index];
+        return lines[token.start_line].substr(token.start_column, token.end_column - token.start_column + 1);
+    };
+
+    // The classes of this file, merged into m_classes once the whole file is read.
+    std::map<std::string, Class, std::less<>> classes;
+    auto add_class = [&](std::string_view name, size_t brace) -> Class& {
+        auto& added = classes.try_emplace(std::string { name }).first->second;
+        // The base clause runs from the ':' after the name to the brace.
+        size_t position = brace;
+        while (position > 0 && text(position - 1).data() != name.data())
+            --position;
+        if (position < brace && text(position) == "final")
+            ++position;
+        if (position == brace || text(position) != ":")
+            return added;
+        std::vector<std::string_view> base;
+        auto add_base = [&] {
+            std::erase_if(base, [](auto token) { return token == "public" || token == "protected" || token == "private" || token == "virtual"; });
+            auto base_name = ParsedType::parse(join_type(base)).name;
+            if (!base_name.empty() && std::ranges::find(added.bases, base_name) == added.bases.end())
+                added.bases.push_back(std::move(base_name));
+            base.clear();
+        };
+        int nesting = 0;
+        for (++position; position < brace; ++position) {
+            auto token = text(position);
+            if (token == "," && nesting == 0)
+                add_base();
+            else
+                base.push_back(token);
+            nesting += nesting_change(token);
+        }
+        add_base();
+        return added;
+    };
+
+    auto add_declaration = [&](std::string_view class_name, Class& owner, size_t begin, size_t end) {
+        std::vector<std::string_view> declaration;
+        for (size_t i = begin; i < end; ++i)
+            declaration.push_back(text(i));
+
+        // template<...> void f();
+        if (!declaration.empty() && declaration[0] == "template") {
+            int nesting = 0;
+            size_t i = 1;
+            for (; i < declaration.size(); ++i) {
+                nesting += nesting_change(declaration[i]);
+                if (nesting <= 0)
+                    break;
+            }
+            declaration.erase(declaration.begin(), declaration.begin() + std::min(i + 1, declaration.size()));
+        }
+        // Leading macros like AK_MAKE_NONCOPYABLE(Foo) and [[nodiscard]].
+        while (declaration.size() > 1 && ((is_macro_name(declaration[0]) && declaration[1] == "(") || (declaration[0] == "[" && declaration[1] == "["))) {
+            int nesting = 0;
+            size_t i = declaration[0] == "[" ? 0 : 1;
+            for (; i < declaration.size(); ++i) {
+                nesting += nesting_change(declaration[i]);
+                if (nesting == 0)
+                    break;
+            }
+            declaration.erase(declaration.begin(), declaration.begin() + std::min(i + 1, declaration.size()));
+        }
+        std::erase_if(declaration, is_specifier);
+        if (declaration.empty())
+            return;
+        static constexpr std::array<std::string_view, 11> skipped {
+            "using", "typedef", "friend", "static_assert", "enum", "class", "struct", "union", "operator", "~", "template"
+        };
+        if (std::ranges::find(skipped, declaration[0]) != skipped.end())
+            return;
+        if (std::ranges::find(declaration, "operator") != declaration.end())
+            return;
+
+        // The first token at the top level that ends the type and the name.
+        int nesting = 0;
+        size_t cut = 0;
+        for (; cut < declaration.size(); ++cut) {
+            auto token = declaration[cut];
+            if (nesting == 0 && (token == "(" || token == "=" || token == "{" || token == "[" || token == ":" || token == ","))
+                break;
+            nesting += nesting_change(token);
+        }
+        if (cut == 0 || !is_identifier(declaration[cut - 1]))
+            return;
+        auto name = declaration[cut - 1];
+        std::span<std::string_view const> type_tokens { declaration.data(), cut - 1 };
+        if (type_tokens.empty() || name == class_name)
+            return;
+
+        if (cut < declaration.size() && declaration[cut] == "(") {
+            std::string type = join_type(type_tokens);
+            // auto f() -> Type
+            if (type == "auto") {
+                auto arrow = std::ranges::find(declaration, "->");
+                if (arrow != declaration.end()) {
+                    auto type_end = std::find_if(arrow + 1, declaration.end(), [](auto token) {
+                        return token == "override" || token == "final" || token == "noexcept" || token == "=";
+                    });
+                    type = join_type({ arrow + 1, type_end });
+                }
+            }
+            owner.members.try_emplace(std::string { name }, Member { std::move(type), MemberKind::Method });
+            return;
+        }
+
+        // Fields, maybe several: `int m_x { 0 }, m_y;`
+        auto type = join_type(type_tokens);
+        owner.members.try_emplace(std::string { name }, Member { type, MemberKind::Field });
+        nesting = 0;
+        std::string_view declarator_name;
+        bool in_initializer = false;
+        for (; cut < declaration.size(); ++cut) {
+            auto token = declaration[cut];
+            if (nesting == 0 && token == ",") {
+                if (!declarator_name.empty())
+                    owner.members.try_emplace(std::string { declarator_name }, Member { type, MemberKind::Field });
+                declarator_name = {};
+                in_initializer = false;
+                continue;
+            }
+            if (nesting == 0 && (token == "=" || token == "{" || token == "[" || token == ":"))
+                in_initializer = true;
+            if (nesting == 0 && !in_initializer && is_identifier(token))
+                declarator_name = token;
+            nesting += nesting_change(token);
+        }
+        if (!declarator_name.empty())
+            owner.members.try_emplace(std::string { declarator_name }, Member { type, MemberKind::Field });
+    };
+
+    struct Scope {
+        // Set for class bodies.
+        std::string_view class_name;
+        Class* owner { nullptr };
+    };
+    std::vector<Scope> scopes;
+    size_t declaration_begin = 0;
+    // Parentheses of the declaration being read in a class body, so that
+    // default arguments like `= {}` don't open a scope.
+    int parens = 0;
+    for (size_t i = 0; i < code.size(); ++i) {
+        auto token = text(i);
+        bool in_class_body = !scopes.empty() && scopes.back().owner;
+        if (in_class_body && (token == "(" || token == ")")) {
+            parens += token == "(" ? 1 : -1;
+            continue;
+        }
+        if (in_class_body && parens > 0)
+            continue;
+
+        if (token == "{") {
+            auto scope = class_of_scope(code, i, text);
+            if (scope && scope->is_class_body) {
+                scopes.push_back({ scope->name, &add_class(scope->name, i) });
+            } else {
+                // A member function body or a braced initializer, the declaration ends here.
+                if (in_class_body)
+                    add_declaration(scopes.back().class_name, *scopes.back().owner, declaration_begin, i);
+                scopes.push_back({});
+            }
+            declaration_begin = i + 1;
+            parens = 0;
+        } else if (token == "}") {
+            if (!scopes.empty())
+                scopes.pop_back();
+            declaration_begin = i + 1;
+            parens = 0;
+        } else if (token == ";") {
+            if (in_class_body)
+                add_declaration(scopes.back().class_name, *scopes.back().owner, declaration_begin, i);
+            declaration_begin = i + 1;
+        } else if (token == ":" && in_class_body && i > declaration_begin) {
+            // An access label, maybe after a macro without a semicolon like C_OBJECT(Foo).
+            auto label = text(i - 1);
+            if (label == "public" || label == "protected" || label == "private")
+                declaration_begin = i + 1;
+        }
+    }
+    if (!scopes.empty())
+        throw std::runtime_error(fmt::format("{}: unbalanced braces", path));
+
+    // merge() leaves the classes that an earlier file defined in `classes`,
+    // their first declarations win.
+    m_classes.merge(classes);
+    for (auto& [name, reopened] : classes) {
+        auto& owner = m_classes.find(name)->second;
+        for (auto& base : reopened.bases) {
+            if (std::ranges::find(owner.bases, base) == owner.bases.end())
+                owner.bases.push_back(std::move(base));
+        }
+        owner.members.merge(reopened.members);
+    }
+}
+
+size_t SymbolDatabase::Builder::member_count() const
+{
+    size_t count = 0;
+    for (auto const& [name, owner] : m_classes)
+        count += owner.members.size();
+    return count;
+}
+
+void SymbolDatabase::Builder::write(std::string const& path) const
+{
+    std::string strings;
+    std::map<std::string_view, StringRef> interned;
+    auto intern = [&](std::string_view text) {
+        auto [it, inserted] = interned.try_emplace(text);
+        if (inserted) {
+            it->second = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size()) };
+            strings += text;
+        }
+        return it->second;
+    };
+
+    std::vector<MemberEntry> members;
+    std::vector<uint64_t> member_hashes;
+    std::vector<ClassEntry> classes;
+    std::vector<StringRef> bases;
+    for (auto const& [class_name, owner] : m_classes) {
+        auto name = intern(class_name);
+        classes.push_back({ name, static_cast<uint32_t>(bases.size()), static_cast<uint32_t>(owner.bases.size()) });
+        for (auto const& base : owner.bases)
+            bases.push_back(intern(base));
+        for (auto const& [member_name, member] : owner.members) {
+            members.push_back({ name, intern(member_name), intern(member.type), member.kind });
+            member_hashes.push_back(hash_of(class_name, member_name));
+        }
+    }
+
+    auto fill_slots = [](std::vector<uint32_t>& slots, size_t count, auto const& hash_at) {
+        slots.assign(slot_count_for(count), 0);
+        for (size_t index = 0; index < count; ++index) {
+            auto slot = hash_at(index) & (slots.size() - 1);
+            while (slots[slot])
+                slot = (slot + 1) & (slots.size() - 1);
+            slots[slot] = index + 1;
+        }
+    };
+    std::vector<uint32_t> member_slots;
+    fill_slots(member_slots, members.size(), [&](size_t index) { return member_hashes[index]; });
+    std::vector<uint32_t> class_slots;
+    fill_slots(class_slots, classes.size(), [&](size_t index) {
+        auto const& name = classes[index].name;
+        return hash_of(std::string_view { strings }.substr(name.offset, name.length));
+    });
+
+    Header header {
+        database_magic,
+        database_version,
+        static_cast<uint32_t>(members.size()),
+        static_cast<uint32_t>(member_slots.size()),
+        static_cast<uint32_t>(classes.size()),
+        static_cast<uint32_t>(class_slots.size()),
+        static_cast<uint32_t>(bases.size()),
+        static_cast<uint32_t>(strings.size()),
+    };
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    auto write_bytes = [&](void const* data, size_t size) {
+        file.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+    };
+    write_bytes(&header, sizeof(header));
+    write_bytes(members.data(), members.size() * sizeof(MemberEntry));
+    write_bytes(member_slots.data(), member_slots.size() * sizeof(uint32_t));
+    write_bytes(classes.data(), classes.size() * sizeof(ClassEntry));
+    write_bytes(class_slots.data(), class_slots.size() * sizeof(uint32_t));
+    write_bytes(bases.data(), bases.size() * sizeof(StringRef));
+    write_bytes(strings.data(), strings.size());
+    file.close();
+    if (!file)
+        throw std::runtime_error(fmt::format("unable to write {}", path));
+}
+
+SymbolDatabase SymbolDatabase::open(std::string const& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error(fmt::format("unable to open {}: {}", path, strerror(errno)));
+    struct stat status {};
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw std::runtime_error(fmt::format("unable to stat {}: {}", path, strerror(errno)));
+    }
+    size_t size = status.st_size;
+    if (size < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error(fmt::format("{} is not a symbol database", path));
+    }
+    auto* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error(fmt::format("unable to map {}: {}", path, strerror(errno)));
+
+    SymbolDatabase database { data, size };
+    auto const& header = *database.m_header;
+    if (header.magic != database_magic || header.version != database_version)
+        throw std::runtime_error(fmt::format("{} is not a symbol database of version {}", path, database_version));
+    auto expected_size = sizeof(Header)
+        + uint64_t { header.member_count } * sizeof(MemberEntry)
+        + uint64_t { header.member_slot_count } * sizeof(uint32_t)
+        + uint64_t { header.class_count } * sizeof(ClassEntry)
+        + uint64_t { header.class_slot_count } * sizeof(uint32_t)
+        + uint64_t { header.base_count } * sizeof(StringRef)
+        + header.string_bytes;
+    if (expected_size != size || !std::has_single_bit(header.member_slot_count) || !std::has_single_bit(header.class_slot_count))
+        throw std::runtime_error(fmt::format("{} is truncated or corrupt", path));
+
+    auto const* position = static_cast<char const*>(data) + sizeof(Header);
+    auto take = [&]<typename T>(T const*& array, uint32_t count) {
+        array = reinterpret_cast<T const*>(position);
+        position += count * sizeof(T);
+    };
+    take(database.m_members, header.member_count);
+    take(database.m_member_slots, header.member_slot_count);
+    take(database.m_classes, header.class_count);
+    take(database.m_class_slots, header.class_slot_count);
+    take(database.m_bases, header.base_count);
+    database.m_strings = position;
+    return database;
+}
+
+SymbolDatabase::SymbolDatabase(void const* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+    , m_header(static_cast<Header const*>(data))
+{
+}
+
+SymbolDatabase::SymbolDatabase(SymbolDatabase&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+SymbolDatabase& SymbolDatabase::operator=(SymbolDatabase&& other) noexcept
+{
+    if (this != &other) {
+        if (m_data)
+            munmap(const_cast<void*>(m_data), m_size);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_header = other.m_header;
+        m_members = other.m_members;
+        m_member_slots = other.m_member_slots;
+        m_classes = other.m_classes;
+        m_class_slots = other.m_class_slots;
+        m_bases = other.m_bases;
+        m_strings = other.m_strings;
+    }
+    return *this;
+}
+
+SymbolDatabase::~SymbolDatabase()
+{
+    if (m_data)
+        munmap(const_cast<void*>(m_data), m_size);
+}
+
+std::string_view SymbolDatabase::string(StringRef const& ref) const
+{
+    // The references are not checked when the file is opened.
+    if (uint64_t { ref.offset } + ref.length > m_header->string_bytes)
+        return {};
+    return { m_strings + ref.offset, ref.length };
+}
+
+SymbolDatabase::MemberEntry const* SymbolDatabase::find_own_member(std::string_view class_name, std::string_view member) const
+{
+    // A corrupt table may have no empty slot, a miss has probed them all.
+    auto mask = m_header->member_slot_count - 1;
+    auto slot = hash_of(class_name, member) & mask;
+    for (uint32_t probe = 0; probe < m_header->member_slot_count; ++probe, slot = (slot + 1) & mask) {
+        auto index = m_member_slots[slot];
+        if (index == 0 || index > m_header->member_count)
+            return nullptr;
+        auto const& entry = m_members[index - 1];
+        if (string(entry.name) == member && string(entry.class_name) == class_name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+SymbolDatabase::ClassEntry const* SymbolDatabase::find_class(std::string_view class_name) const
+{
+    auto mask = m_header->class_slot_count - 1;
+    auto slot = hash_of(class_name) & mask;
+    for (uint32_t probe = 0; probe < m_header->class_slot_count; ++probe, slot = (slot + 1) & mask) {
+        auto index = m_class_slots[slot];
+        if (index == 0 || index > m_header->class_count)
+            return nullptr;
+        auto const& entry = m_classes[index - 1];
+        if (string(entry.name) == class_name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+std::optional<SymbolDatabase::MemberType> SymbolDatabase::find_member(std::string_view class_name, std::string_view member) const
+{
+    // Breadth first through the bases, the nearest declaration wins.
+    std::vector<std::string_view> classes { class_name };
+    for (int depth = 0; depth <= max_base_depth && !classes.empty(); ++depth) {
+        std::vector<std::string_view> bases;
+        for (auto name : classes) {
+            if (auto const* entry = find_own_member(name, member))
+                return MemberType { string(entry->type), entry->kind };
+            auto const* owner = find_class(name);
+            if (!owner || uint64_t { owner->first_base } + owner->base_count > m_header->base_count)
+                continue;
+            for (uint32_t i = 0; i < owner->base_count; ++i)
+                bases.push_back(string(m_bases[owner->first_base + i]));
+        }
+        classes = std::move(bases);
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string_view> enclosing_class(std::vector<ClassScope> const& scopes, size_t index)
+{
+    // The scopes around `index` are the last one that opens before it and its parents.
+    auto next = std::ranges::lower_bound(scopes, index, {}, &ClassScope::open);
+    if (next == scopes.begin())
+        return std::nullopt;
+    std::optional<size_t> scope = next - scopes.begin() - 1;
+    while (scope && scopes[*scope].close < index)
+        scope = scopes[*scope].parent;
+    if (!scope)
+        return std::nullopt;
+    return scopes[*scope].name;
+}
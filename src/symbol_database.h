@@ -0,0 +1,215 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "packed_token.h"
+
+// A type as written in a declaration, taken apart: "NonnullRefPtr<Node const>
+// const&" has the name "NonnullRefPtr" and the argument "Node const".
+struct ParsedType {
+    // Unqualified, "Vector" for "AK::Vector<int>".
+    std::string name;
+    std::vector<std::string> arguments;
+    bool is_pointer { false };
+
+    static ParsedType parse(std::string_view type);
+    // The type without the pointer, references and cv-qualifiers.
+    std::string value_type() const;
+};
+
+// The members of every class of a source tree and their declared types, so
+// that the type of a receiver like `m_builder` in `m_builder.append(` is known
+// without parsing the header that declares it.
+//
+// A Builder scans the sources once (see `ak_to_std --index`) and writes the
+// database to a file. SymbolDatabase maps that file and answers lookups from
+// the mapping directly: the members and the classes are in hash tables that
+// are stored as they are used, so opening the database reads nothing but its
+// header. Classes are keyed on their unqualified name, namespaces are not
+// told apart.
+class SymbolDatabase {
+public:
+    enum class MemberKind : uint32_t {
+        Field,
+        Method,
+    };
+
+    class Builder {
+    public:
+        // Adds the classes defined in `content`, `path` is only used in errors.
+        // Throws std::runtime_error and adds nothing if the braces don't balance.
+        void add_source(std::string_view path, std::string_view content);
+        // Throws std::runtime_error if the file can't be written.
+        void write(std::string const& path) const;
+
+        size_t class_count() const { return m_classes.size(); }
+        size_t member_count() const;
+
+    private:
+        struct Member {
+            std::string type;
+            MemberKind kind;
+        };
+        struct Class {
+            std::vector<std::string> bases;
+            // The first declaration of a name wins, e.g. of overloads.
+            std::map<std::string, Member, std::less<>> members;
+        };
+        std::map<std::string, Class, std::less<>> m_classes;
+    };
+
+    // Maps the database at `path`. Throws std::runtime_error if it can't be
+    // read or is not a symbol database of this version.
+    static SymbolDatabase open(std::string const& path);
+
+    SymbolDatabase(SymbolDatabase&& other) noexcept;
+    SymbolDatabase& operator=(SymbolDatabase&& other) noexcept;
+    SymbolDatabase(SymbolDatabase const&) = delete;
+    SymbolDatabase& operator=(SymbolDatabase const&) = delete;
+    ~SymbolDatabase();
+
+    struct MemberType {
+        // As declared, e.g. "Vector<String> const&".
+        std::string_view type;
+        MemberKind kind;
+    };
+    // The member `member` of `class_name` or of one of its base classes.
+    std::optional<MemberType> find_member(std::string_view class_name, std::string_view member) const;
+
+private:
+    struct Header;
+    struct StringRef;
+    struct MemberEntry;
+    struct ClassEntry;
+
+    SymbolDatabase(void const* data, size_t size);
+
+    std::string_view string(StringRef const& ref) const;
+    MemberEntry const* find_own_member(std::string_view class_name, std::string_view member) const;
+    ClassEntry const* find_class(std::string_view class_name) const;
+
+    void const* m_data { nullptr };
+    size_t m_size { 0 };
+    Header const* m_header { nullptr };
+    MemberEntry const* m_members { nullptr };
+    uint32_t const* m_member_slots { nullptr };
+    ClassEntry const* m_classes { nullptr };
+    uint32_t const* m_class_slots { nullptr };
+    StringRef const* m_bases { nullptr };
+    char const* m_strings { nullptr };
+};
+
+struct ScopeClass {
+    std::string_view name;
+    // True if the scope is the class body, false if it is the body of one of
+    // its member functions.
+    bool is_class_body { false };
+};
+
+// The class of the scope the `{` at `brace` opens: a class body or an
+// out-of-line member function, `Foo::bar() {`. Nullopt for anything else like
+// a namespace, a block or a lambda. `text` gives the text of a token by its
+// index.
+std::optional<ScopeClass> class_of_scope(PackedTokens const& tokens, size_t brace, auto const& text)
+{
+    auto is_identifier = [&](size_t i) { return static_cast<TokenKind>(tokens[i].type) == TokenKind::Identifier; };
+    int parens = 0;
+    for (size_t i = brace; i-- > 0;) {
+        auto kind = static_cast<TokenKind>(tokens[i].type);
+        if (kind == TokenKind::Comment || kind == TokenKind::Preprocessor)
+            continue;
+        auto token = text(i);
+        if (token == ")") {
+            ++parens;
+        } else if (token == "(") {
+            if (--parens < 0)
+                return std::nullopt;
+            // Foo::bar( or Foo::~Foo(
+            if (parens == 0 && i >= 3 && is_identifier(i - 1)) {
+                auto qualifier = text(i - 2) == "~" ? i - 3 : i - 2;
+                if (qualifier >= 1 && text(qualifier) == "::" && is_identifier(qualifier - 1))
+                    return ScopeClass { text(qualifier - 1) };
+            }
+        } else if (parens > 0) {
+            continue;
+        } else if (token == ";" || token == "{" || token == "namespace") {
+            return std::nullopt;
+        } else if (token == "}") {
+            // Only a braced member initializer, `: m_x { 0 }, m_y(1) {`, is part of the head.
+            auto next = text(i + 1);
+            if (next != "," && next != "{")
+                return std::nullopt;
+            int depth = 0;
+            for (; i > 0; --i) {
+                auto inner = text(i);
+                if (inner == "}")
+                    ++depth;
+                else if (inner == "{" && --depth == 0)
+                    break;
+            }
+        } else if (token == "class" || token == "struct" || token == "union") {
+            if (i > 0 && text(i - 1) == "enum")
+                return std::nullopt;
+            // The name is the last identifier before the base clause, after macros like AK_EXPORT.
+            std::optional<std::string_view> name;
+            for (size_t j = i + 1; j < brace; ++j) {
+                auto part = text(j);
+                if (part == ":" || part == "<" || part == "final")
+                    break;
+                if (is_identifier(j))
+                    name = part;
+            }
+            if (!name)
+                return std::nullopt;
+            return ScopeClass { *name, true };
+        }
+    }
+    return std::nullopt;
+}
+
+// A class scope of a file, see class_scopes().
+struct ClassScope {
+    std::string name;
+    // Token indices of its braces, `close` is the token count if it is not closed.
+    size_t open { 0 };
+    size_t close { 0 };
+    // The innermost class scope this one is in.
+    std::optional<size_t> parent;
+};
+
+// Every class scope of a file in the order they open, see class_of_scope().
+std::vector<ClassScope> class_scopes(PackedTokens const& tokens, auto const& text)
+{
+    struct Brace {
+        // The innermost class scope inside the brace.
+        std::optional<size_t> scope;
+        bool opens_scope { false };
+    };
+    std::vector<ClassScope> scopes;
+    std::vector<Brace> braces;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (static_cast<TokenKind>(tokens[i].type) != TokenKind::Punctuation)
+            continue;
+        auto token = text(i);
+        if (token == "{") {
+            Brace brace { braces.empty() ? std::nullopt : braces.back().scope };
+            if (auto scope = class_of_scope(tokens, i, text)) {
+                scopes.push_back({ std::string { scope->name }, i, tokens.size(), brace.scope });
+                brace = { scopes.size() - 1, true };
+            }
+            braces.push_back(brace);
+        } else if (token == "}" && !braces.empty()) {
+            if (braces.back().opens_scope)
+                scopes[*braces.back().scope].close = i;
+            braces.pop_back();
+        }
+    }
+    return scopes;
+}
+
+// The class whose scope the token at `index` is in, `scopes` are the
+// class_scopes() of its file.
+std::optional<std::string_view> enclosing_class(std::vector<ClassScope> const& scopes, size_t index);
@@ -0,0 +1,109 @@
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <fmt/format.h>
+#include "conversion_stats.h"
+
+namespace {
+
+struct TraceEvent {
+    char const* category;
+    char const* name;
+    std::string detail;
+    int64_t start;
+    int64_t duration;
+};
+
+// Every thread appends to its own buffer, the mutex only guards the list of buffers.
+struct ThreadBuffer {
+    int thread_id { 0 };
+    std::string thread_name;
+    std::vector<TraceEvent> events;
+};
+
+std::atomic<bool> s_tracing { false };
+std::chrono::steady_clock::time_point s_start;
+std::mutex s_buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+ThreadBuffer& thread_buffer()
+{
+    if (!t_buffer) {
+        std::lock_guard lock(s_buffers_mutex);
+        auto& buffer = s_buffers.emplace_back(std::make_unique<ThreadBuffer>());
+        buffer->thread_id = static_cast<int>(s_buffers.size());
+        t_buffer = buffer.get();
+    }
+    return *t_buffer;
+}
+
+// Nanoseconds since start_tracing().
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_start).count();
+}
+
+}
+
+void start_tracing() {
+    s_start = std::chrono::steady_clock::now();
+    s_tracing = true;
+}
+
+bool is_tracing() {
+    return s_tracing.load(std::memory_order_relaxed);
+}
+
+void set_trace_thread_name(std::string name) {
+    if (is_tracing())
+        thread_buffer().thread_name = std::move(name);
+}
+
+void write_trace(std::string const& path) {
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error(fmt::format("unable to write trace {}", path));
+
+    std::lock_guard lock(s_buffers_mutex);
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&] {
+        auto result = first ? "" : ",\n";
+        first = false;
+        return result;
+    };
+    for (auto const& buffer : s_buffers) {
+        if (!buffer->thread_name.empty()) {
+            file << separator() << fmt::format(R"({{"ph":"M","name":"thread_name","pid":1,"tid":{},"args":{{"name":{}}}}})",
+                buffer->thread_id, json_string(buffer->thread_name));
+        }
+        for (auto const& event : buffer->events) {
+            file << separator() << fmt::format(R"({{"ph":"X","cat":"{}","name":"{}","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f})",
+                event.category, event.name, buffer->thread_id, event.start / 1000.0, event.duration / 1000.0);
+            if (!event.detail.empty())
+                file << fmt::format(R"(,"args":{{"detail":{}}})", json_string(event.detail));
+            file << '}';
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+TraceSpan::TraceSpan(char const* category, char const* name) {
+    if (!is_tracing())
+        return;
+    m_category = category;
+    m_name = name;
+    m_start = now();
+}
+
+TraceSpan::~TraceSpan() {
+    if (m_start < 0)
+        return;
+    thread_buffer().events.push_back({ m_category, m_name, std::move(m_detail), m_start, now() - m_start });
+}
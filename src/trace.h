@@ -0,0 +1,53 @@
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include <string>
+
+// Records spans in the Chrome trace-event format, open the written file in
+// chrome://tracing or Perfetto. Spans are only compiled in with the
+// AK_TO_STD_TRACING option, and are only recorded after start_tracing().
+
+void start_tracing();
+bool is_tracing();
+// Names the calling thread in the trace.
+void set_trace_thread_name(std::string name);
+// Writes every span recorded so far. Must not race with threads that are
+// still recording. Throws std::runtime_error if the file can't be written.
+void write_trace(std::string const& path);
+
+// A span from construction to destruction on the calling thread. The string
+// `detail` returns (e.g. the file name) shows up as an argument of the span,
+// it is only called while tracing.
+class TraceSpan {
+public:
+    TraceSpan(char const* category, char const* name);
+    template<std::invocable Detail>
+    TraceSpan(char const* category, char const* name, Detail const& detail)
+        : TraceSpan(category, name)
+    {
+        if (m_start >= 0)
+            m_detail = detail();
+    }
+    ~TraceSpan();
+
+    TraceSpan(TraceSpan const&) = delete;
+    TraceSpan& operator=(TraceSpan const&) = delete;
+
+private:
+    char const* m_category { nullptr };
+    char const* m_name { nullptr };
+    std::string m_detail;
+    int64_t m_start { -1 };
+};
+
+#ifdef AK_TO_STD_TRACING
+#    define TRACE_CONCAT_IMPL(a, b) a##b
+#    define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// The detail argument is not evaluated unless a trace is recorded.
+#    define TRACE_SPAN(category, name, ...) \
+        TraceSpan TRACE_CONCAT(trace_span_, __LINE__) { category, name __VA_OPT__(, [&] { return std::string { __VA_ARGS__ }; }) }
+#else
+#    define TRACE_SPAN(...) \
+        do {                \
+        } while (0)
+#endif
@@ -0,0 +1,124 @@
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "ak_type_model.h"
+#include "convert_ak_to_std.h"
+#include "symbol_database.h"
+#include "test.h"
+
+namespace {
+
+// Exposes the type queries that are protected in ConvertAkToStd.
+class TypeQueryConverter : public ConvertAkToStd {
+public:
+    using ConvertAkToStd::arrow_type;
+    using ConvertAkToStd::member_type;
+};
+
+std::optional<std::string> member_type(std::string_view type, std::string_view member)
+{
+    return AkTypeModel::instance().member_type(ParsedType::parse(type), member);
+}
+
+}
+
+TEST_CASE(parsed_type_takes_qualified_names_apart)
+{
+    auto vector = ParsedType::parse("AK::Vector<int>");
+    EXPECT_EQ(vector.name, "Vector");
+    EXPECT(vector.arguments == std::vector<std::string> { "int" });
+    EXPECT(!vector.is_pointer);
+
+    auto nested = ParsedType::parse("const AK::Detail::Node");
+    EXPECT_EQ(nested.name, "Node");
+    EXPECT(nested.arguments.empty());
+}
+
+TEST_CASE(parsed_type_splits_only_top_level_arguments)
+{
+    auto map = ParsedType::parse("HashMap<String, Vector<Optional<int>>>");
+    EXPECT_EQ(map.name, "HashMap");
+    EXPECT(map.arguments == (std::vector<std::string> { "String", "Vector<Optional<int>>" }));
+    EXPECT_EQ(map.value_type(), "HashMap<String, Vector<Optional<int>>>");
+
+    auto function = ParsedType::parse("Function<void(int, int)>");
+    EXPECT(function.arguments == std::vector<std::string> { "void(int, int)" });
+}
+
+TEST_CASE(parsed_type_value_type_strips_references_pointers_and_cv)
+{
+    auto reference = ParsedType::parse("NonnullRefPtr<Node const> const&");
+    EXPECT_EQ(reference.name, "NonnullRefPtr");
+    EXPECT(reference.arguments == std::vector<std::string> { "Node const" });
+    EXPECT(!reference.is_pointer);
+    EXPECT_EQ(reference.value_type(), "NonnullRefPtr<Node const>");
+
+    auto pointer = ParsedType::parse("const Web::Node*");
+    EXPECT(pointer.is_pointer);
+    EXPECT_EQ(pointer.value_type(), "Node");
+
+    // A pointer inside the arguments does not make the type one.
+    auto vector_of_pointers = ParsedType::parse("Vector<Node*>&&");
+    EXPECT(!vector_of_pointers.is_pointer);
+    EXPECT_EQ(vector_of_pointers.value_type(), "Vector<Node*>");
+}
+
+TEST_CASE(ak_type_model_substitutes_template_arguments)
+{
+    EXPECT_EQ(member_type("Vector<String>", "first"), std::optional<std::string> { "String&" });
+    EXPECT_EQ(member_type("AK::Vector<int> const&", "size"), std::optional<std::string> { "size_t" });
+    EXPECT_EQ(member_type("HashMap<String, Vector<int>>", "get"), std::optional<std::string> { "Optional<Vector<int>>" });
+    EXPECT_EQ(member_type("HashMap<String, int>", "keys"), std::optional<std::string> { "Vector<String>" });
+    EXPECT_EQ(member_type("Optional<NonnullRefPtr<Node>>", "value"), std::optional<std::string> { "NonnullRefPtr<Node>&" });
+    EXPECT_EQ(member_type("RefPtr<Node>", "release_nonnull"), std::optional<std::string> { "NonnullRefPtr<Node>" });
+    EXPECT_EQ(member_type("StringBuilder", "string_view"), std::optional<std::string> { "StringView" });
+    // Only whole identifiers are parameters: the T of "Type" stays.
+    EXPECT_EQ(member_type("Vector<Type>", "span"), std::optional<std::string> { "Span<Type>" });
+    // Without arguments the parameters are left as they are.
+    EXPECT_EQ(member_type("Vector", "first"), std::optional<std::string> { "T&" });
+}
+
+TEST_CASE(ak_type_model_misses_unknown_classes_and_members)
+{
+    EXPECT(!member_type("Node", "first"));
+    EXPECT(!member_type("Vector<int>", "frobnicate"));
+    EXPECT(!member_type("StringBuilder", "first"));
+    EXPECT(!member_type("", "size"));
+    EXPECT(AkTypeModel::covers_include("AK/Vector.h"));
+    EXPECT(!AkTypeModel::covers_include("LibCore/File.h"));
+}
+
+TEST_CASE(arrow_type_follows_pointers_and_smart_pointers)
+{
+    TypeQueryConverter converter;
+    EXPECT_EQ(converter.arrow_type("Node*"), std::optional<std::string> { "Node" });
+    EXPECT_EQ(converter.arrow_type("Web::Node const*"), std::optional<std::string> { "Node" });
+    EXPECT_EQ(converter.arrow_type("NonnullRefPtr<Node>"), std::optional<std::string> { "Node" });
+    EXPECT_EQ(converter.arrow_type("OwnPtr<Web::Node const> const&"), std::optional<std::string> { "Node" });
+    EXPECT_EQ(converter.arrow_type("Optional<Vector<int>>"), std::optional<std::string> { "Vector<int>" });
+    EXPECT(!converter.arrow_type("int"));
+    EXPECT(!converter.arrow_type("Vector<Node*>"));
+}
+
+TEST_CASE(member_type_falls_back_to_the_symbol_database)
+{
+    SymbolDatabase::Builder builder;
+    builder.add_source("Node.h", "class Node {\n    Vector<String> m_names;\n    Node* parent() const;\n};\n");
+    auto path = (std::filesystem::temp_directory_path() / fmt::format("ak-to-std-tests-{}-types.symdb", getpid())).string();
+    builder.write(path);
+    auto database = SymbolDatabase::open(path);
+    std::filesystem::remove(path);
+
+    TypeQueryConverter converter;
+    EXPECT(!converter.member_type("Node", "m_names"));
+    converter.set_symbol_database(&database);
+    EXPECT_EQ(converter.member_type("Node const&", "m_names"), std::optional<std::string> { "Vector<String>" });
+    EXPECT_EQ(converter.member_type("RefPtr<Node>", "ptr"), std::optional<std::string> { "Node*" });
+    EXPECT(!converter.member_type("Node", "m_children"));
+    // The chain m_node->parent()->m_names.
+    auto parent = converter.member_type(*converter.arrow_type("NonnullRefPtr<Node>"), "parent");
+    EXPECT_EQ(parent, std::optional<std::string> { "Node*" });
+    EXPECT_EQ(converter.member_type(*converter.arrow_type(*parent), "m_names"), std::optional<std::string> { "Vector<String>" });
+}
@@ -0,0 +1,120 @@
+#include <optional>
+#include <string>
+#include <string_view>
+#include "include_rewriter.h"
+#include "rule_set.h"
+#include "test.h"
+
+namespace {
+
+RuleSet rules_from(std::string_view text)
+{
+    RuleSet rules;
+    rules.add_rules(text, "test.rules");
+    return rules;
+}
+
+// The rewritten line, "dropped" if the #include is dropped and "none" if no rule matches.
+std::string rewrite(IncludeRewriter& rewriter, std::string_view argument)
+{
+    auto rewrite = rewriter.rewrite(argument);
+    if (!rewrite)
+        return "none";
+    if (rewrite->is_unterminated)
+        return "unterminated";
+    if (!rewrite->line)
+        return "dropped";
+    return std::string { *rewrite->line };
+}
+
+}
+
+TEST_CASE(include_rewriter_uses_the_longest_matching_root)
+{
+    auto rules = rules_from(
+        "include <Lib/ <lib/\n"
+        "include <Lib/Core/ \"core/\n"
+        "include <Lib/Core/Private/ <private/\n");
+    IncludeRewriter rewriter { rules, "" };
+    EXPECT_EQ(rewrite(rewriter, "<Lib/Gfx/Bitmap.h>"), "#include <lib/Gfx/Bitmap.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Lib/Core/File.h>"), "#include \"core/File.h\"");
+    EXPECT_EQ(rewrite(rewriter, "<Lib/Core/Private/Impl.h>"), "#include <private/Impl.h>");
+    // A root is only a prefix of the path, not of a path component.
+    EXPECT_EQ(rewrite(rewriter, "<Lib/CoreX/File.h>"), "#include <lib/CoreX/File.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Lib/Core/PrivateX.h>"), "#include \"core/PrivateX.h\"");
+    EXPECT_EQ(rewrite(rewriter, "<Li/File.h>"), "none");
+    EXPECT_EQ(rewrite(rewriter, "<Other/File.h>"), "none");
+    EXPECT_EQ(rewrite(rewriter, ""), "none");
+
+    auto match = rewriter.rewrite("<Lib/Core/File.h>");
+    EXPECT(match && match->rule == "#include <Lib/Core/");
+}
+
+TEST_CASE(include_rewriter_converts_the_casing)
+{
+    auto rules = rules_from(
+        "include <Keep/ <keep/ keep\n"
+        "include <Lower/ <lower/ lower\n"
+        "include <Snake/ <snake/ snake\n");
+    IncludeRewriter rewriter { rules, "" };
+    EXPECT_EQ(rewrite(rewriter, "<Keep/HTTPServer.h>"), "#include <keep/HTTPServer.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Lower/HTTPServer.h>"), "#include <lower/httpserver.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Snake/HTTPServer.h>"), "#include <snake/http_server.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Snake/EventLoop.h>"), "#include <snake/event_loop.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Snake/Base64URL.h>"), "#include <snake/base64_url.h>");
+    // Every path component on its own.
+    EXPECT_EQ(rewrite(rewriter, "<Snake/LibFoo/DOMParser.h>"), "#include <snake/lib_foo/dom_parser.h>");
+    EXPECT_EQ(rewrite(rewriter, "<Snake/already_snake/x.h>"), "#include <snake/already_snake/x.h>");
+}
+
+TEST_CASE(include_rewriter_appends_the_suffix_and_changes_the_delimiter)
+{
+    auto rules = rules_from(
+        "include <Lib/ \"lib/ snake h\n"
+        "include \"Quoted/ <quoted/ keep pp\n");
+    IncludeRewriter rewriter { rules, "" };
+    EXPECT_EQ(rewrite(rewriter, "<Lib/EventLoop.h>"), "#include \"lib/event_loop.hh\"");
+    EXPECT_EQ(rewrite(rewriter, "\"Quoted/File.h\""), "#include <quoted/File.hpp>");
+}
+
+TEST_CASE(include_rewriter_drops_roots_and_unterminated_arguments)
+{
+    auto rules = rules_from(
+        "drop-include <Dropped/\n"
+        "include <Lib/ <lib/\n");
+    IncludeRewriter rewriter { rules, "" };
+    EXPECT_EQ(rewrite(rewriter, "<Dropped/Anything.h>"), "dropped");
+    auto dropped = rewriter.rewrite("<Dropped/Anything.h>");
+    EXPECT(dropped && dropped->rule == "#include <Dropped/" && !dropped->is_unterminated);
+    EXPECT_EQ(rewrite(rewriter, "<Lib/Open.h"), "unterminated");
+    EXPECT_EQ(rewrite(rewriter, "<Lib/Open.h"), "unterminated");
+    // Text after the closing delimiter is not part of the path.
+    EXPECT_EQ(rewrite(rewriter, "<Lib/File.h> // comment"), "#include <lib/File.h>");
+}
+
+TEST_CASE(include_rewriter_interns_rewritten_lines)
+{
+    auto rules = rules_from("include <Lib/ <lib/ snake\n");
+    IncludeRewriter rewriter { rules, "" };
+    std::string argument = "<Lib/EventLoop.h>";
+    auto first = rewriter.rewrite(argument);
+    argument = "<Lib/EventLoop.h>";
+    auto second = rewriter.rewrite(argument);
+    EXPECT(first && first->line && second && second->line);
+    if (first && first->line && second && second->line) {
+        EXPECT_EQ(*first->line, "#include <lib/event_loop.h>");
+        // The same interned string, not an equal copy.
+        EXPECT(first->line->data() == second->line->data());
+    }
+    auto other = rewriter.rewrite("<Lib/Timer.h>");
+    EXPECT(other && other->line && other->line->data() != first->line->data());
+}
+
+TEST_CASE(include_rewriter_puts_the_include_path_under_built_in_rules)
+{
+    IncludeRewriter rewriter { RuleSet::built_in(), "cpp_parser/" };
+    EXPECT_EQ(rewrite(rewriter, "<AK/Vector.h>"), "dropped");
+    EXPECT_EQ(rewrite(rewriter, "\"Parser/AST.h\""), "#include \"cpp_parser/parser/ast.hh\"");
+    EXPECT_EQ(rewrite(rewriter, "<LibCpp/Lexer.h>"), "#include \"cpp_parser/lexer.hh\"");
+    EXPECT_EQ(rewrite(rewriter, "<vector>"), "none");
+}
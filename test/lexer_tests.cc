@@ -0,0 +1,132 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include "lexer.h"
+#include "test.h"
+
+namespace {
+
+struct Token {
+    TokenKind kind;
+    std::string text;
+    uint32_t line;
+
+    bool operator==(Token const&) const = default;
+};
+
+std::vector<Token> lex(std::vector<std::string_view> const& lines)
+{
+    PackedTokens tokens;
+    LexState state = LexState::Code;
+    for (size_t i = 0; i < lines.size(); ++i)
+        lex_line(lines[i], static_cast<uint32_t>(i), state, tokens);
+
+    std::vector<Token> result;
+    for (auto const& token : tokens) {
+        auto line = lines[token.start_line];
+        auto text = line.substr(token.start_column, token.end_column + 1 - token.start_column);
+        result.push_back({ static_cast<TokenKind>(token.type), std::string { text }, token.start_line });
+    }
+    return result;
+}
+
+}
+
+TEST_CASE(lexer_splits_identifiers_and_punctuation)
+{
+    auto tokens = lex({ "x <<= y->z;" });
+    std::vector<Token> expected {
+        { TokenKind::Identifier, "x", 0 },
+        { TokenKind::Punctuation, "<<=", 0 },
+        { TokenKind::Identifier, "y", 0 },
+        { TokenKind::Punctuation, "->", 0 },
+        { TokenKind::Identifier, "z", 0 },
+        { TokenKind::Punctuation, ";", 0 },
+    };
+    EXPECT(tokens == expected);
+}
+
+TEST_CASE(lexer_keeps_raw_strings_whole)
+{
+    auto tokens = lex({ R"~(auto s = R"x(a ")" b)x"; f(u8R"(y)");)~" });
+    std::vector<Token> expected {
+        { TokenKind::Identifier, "auto", 0 },
+        { TokenKind::Identifier, "s", 0 },
+        { TokenKind::Punctuation, "=", 0 },
+        { TokenKind::String, R"~(R"x(a ")" b)x")~", 0 },
+        { TokenKind::Punctuation, ";", 0 },
+        { TokenKind::Identifier, "f", 0 },
+        { TokenKind::Punctuation, "(", 0 },
+        { TokenKind::String, R"~(u8R"(y)")~", 0 },
+        { TokenKind::Punctuation, ")", 0 },
+        { TokenKind::Punctuation, ";", 0 },
+    };
+    EXPECT(tokens == expected);
+}
+
+TEST_CASE(lexer_ends_an_unterminated_raw_string_at_the_end_of_the_line)
+{
+    auto tokens = lex({ R"~(x = R"(open)~", "y;" });
+    std::vector<Token> expected {
+        { TokenKind::Identifier, "x", 0 },
+        { TokenKind::Punctuation, "=", 0 },
+        { TokenKind::String, R"~(R"(open)~", 0 },
+        { TokenKind::Identifier, "y", 1 },
+        { TokenKind::Punctuation, ";", 1 },
+    };
+    EXPECT(tokens == expected);
+}
+
+TEST_CASE(lexer_yields_one_comment_token_per_line_of_a_block_comment)
+{
+    auto tokens = lex({ "a /* one", "", "two", "three */ b /* c */ d // e" });
+    std::vector<Token> expected {
+        { TokenKind::Identifier, "a", 0 },
+        { TokenKind::Comment, "/* one", 0 },
+        { TokenKind::Comment, "two", 2 },
+        { TokenKind::Comment, "three */", 3 },
+        { TokenKind::Identifier, "b", 3 },
+        { TokenKind::Comment, "/* c */", 3 },
+        { TokenKind::Identifier, "d", 3 },
+        { TokenKind::Comment, "// e", 3 },
+    };
+    EXPECT(tokens == expected);
+}
+
+TEST_CASE(lexer_does_not_start_comments_inside_strings)
+{
+    auto tokens = lex({ R"~(s = "/* \" //"; 'x')~" });
+    std::vector<Token> expected {
+        { TokenKind::Identifier, "s", 0 },
+        { TokenKind::Punctuation, "=", 0 },
+        { TokenKind::String, R"~("/* \" //")~", 0 },
+        { TokenKind::Punctuation, ";", 0 },
+        { TokenKind::Character, "'x'", 0 },
+    };
+    EXPECT(tokens == expected);
+}
+
+TEST_CASE(lexer_takes_include_paths_as_one_string)
+{
+    auto tokens = lex({ "#include <AK/Vector.h>", "#  include \"Foo.h\" // x", "#define A <B>" });
+    std::vector<Token> expected {
+        { TokenKind::Preprocessor, "#include", 0 },
+        { TokenKind::String, "<AK/Vector.h>", 0 },
+        { TokenKind::Preprocessor, "#  include", 1 },
+        { TokenKind::String, "\"Foo.h\"", 1 },
+        { TokenKind::Comment, "// x", 1 },
+        { TokenKind::Preprocessor, "#define", 2 },
+        { TokenKind::Identifier, "A", 2 },
+        { TokenKind::Punctuation, "<", 2 },
+        { TokenKind::Identifier, "B", 2 },
+        { TokenKind::Punctuation, ">", 2 },
+    };
+    EXPECT(tokens == expected);
+}
+
+TEST_CASE(lexer_only_takes_a_hash_at_the_start_of_a_line_as_a_directive)
+{
+    auto tokens = lex({ "a # b" });
+    EXPECT_EQ(tokens.size(), 3u);
+    EXPECT(tokens[1] == (Token { TokenKind::Punctuation, "#", 0 }));
+}
@@ -0,0 +1,135 @@
+#include <string>
+#include <unordered_map>
+#include "convert_ak_to_std.h"
+#include "line_cache.h"
+#include "test.h"
+
+namespace {
+
+LineCache::Entry entry_with_line(std::string line)
+{
+    LineCache::Entry entry;
+    entry.line = std::move(line);
+    return entry;
+}
+
+// Two different lines that share the bit that remembers their first lookup
+// and the shard of the cache, see LineCache::find().
+std::pair<std::string, std::string> lines_sharing_a_shard_and_seen_bit()
+{
+    std::unordered_map<uint64_t, std::string> lines;
+    for (size_t i = 0;; ++i) {
+        auto line = fmt::format("int x{};", i);
+        auto hash = std::hash<std::string_view> {}(line);
+        auto key = (hash % (1 << 20)) | ((hash >> 32) % 64) << 20;
+        auto [it, inserted] = lines.try_emplace(key, line);
+        if (!inserted)
+            return { it->second, line };
+    }
+}
+
+}
+
+TEST_CASE(line_cache_adds_a_line_on_its_second_lookup)
+{
+    LineCache cache { 1 << 20 };
+    auto first = cache.find("int x;");
+    EXPECT(!first.entry);
+    EXPECT(!first.worth_caching);
+    auto second = cache.find("int x;");
+    EXPECT(!second.entry);
+    EXPECT(second.worth_caching);
+
+    cache.insert("int x;", entry_with_line("int y;"));
+    auto third = cache.find("int x;");
+    EXPECT(third.entry && third.entry->line == "int y;");
+    EXPECT(!cache.find("int z;").worth_caching);
+}
+
+TEST_CASE(line_cache_stops_adding_at_max_bytes)
+{
+    LineCache cache { 1000 };
+    size_t inserted = 0;
+    for (size_t i = 0; i < 100; ++i) {
+        auto line = fmt::format("int line{};", i);
+        cache.insert(line, entry_with_line(line));
+        if (cache.find(line).entry)
+            ++inserted;
+        EXPECT(cache.size_in_bytes() <= 1000);
+    }
+    EXPECT(inserted > 0);
+    EXPECT(inserted < 100);
+
+    // Once full, nothing more is added.
+    auto size = cache.size_in_bytes();
+    cache.insert("int late;", entry_with_line("int late;"));
+    EXPECT(!cache.find("int late;").entry);
+    EXPECT_EQ(cache.size_in_bytes(), size);
+
+    // An entry larger than the whole cache is never added.
+    LineCache small { 100 };
+    small.insert(std::string(200, 'x'), entry_with_line("x"));
+    EXPECT(!small.find(std::string(200, 'x')).entry);
+    EXPECT_EQ(small.size_in_bytes(), 0u);
+}
+
+TEST_CASE(line_cache_keys_on_the_full_text)
+{
+    auto [a, b] = lines_sharing_a_shard_and_seen_bit();
+    EXPECT(a != b);
+    LineCache cache { 1 << 20 };
+    EXPECT(!cache.find(a).worth_caching);
+    // The shared bit makes the first lookup of `b` look like its second one.
+    EXPECT(cache.find(b).worth_caching);
+
+    cache.insert(a, entry_with_line("a"));
+    EXPECT(!cache.find(b).entry);
+    cache.insert(b, entry_with_line("b"));
+    EXPECT(cache.find(a).entry && cache.find(a).entry->line == "a");
+    EXPECT(cache.find(b).entry && cache.find(b).entry->line == "b");
+    // An entry is never replaced.
+    cache.insert(a, entry_with_line("again"));
+    EXPECT(cache.find(a).entry->line == "a");
+}
+
+TEST_CASE(line_cache_entries_that_depend_on_tokens_are_not_replayed)
+{
+    // Only lines that the prefilter flags go through the cache.
+    constexpr std::string_view content = "    VERIFY(x);\n    return adopt_ref(*new Node());\n";
+    LineCache cache { 1 << 20 };
+    // Entries the converter would never write, to tell replayed lines apart.
+    cache.insert("    VERIFY(x);", entry_with_line("int replayed;"));
+    LineCache::Entry token_entry;
+    token_entry.depends_on_tokens = true;
+    token_entry.line = "POISON";
+    cache.insert("    return adopt_ref(*new Node());", std::move(token_entry));
+
+    ConvertAkToStd converter;
+    converter.set_line_cache(&cache);
+    converter.add_file("a.cpp", content);
+    auto output = converter.convert_to_string("a.cpp");
+    EXPECT(output.find("int replayed;") != std::string::npos);
+    EXPECT(output.find("POISON") == std::string::npos);
+    EXPECT(output.find("return new Node();") != std::string::npos);
+}
+
+TEST_CASE(line_cache_records_lines_that_use_tokens_without_their_text)
+{
+    constexpr std::string_view content = "    VERIFY(x);\n    return adopt_ref(*new Node());\n";
+    LineCache cache { 1 << 20 };
+    std::string outputs[3];
+    for (auto& output : outputs) {
+        ConvertAkToStd converter;
+        converter.set_line_cache(&cache);
+        converter.add_file("a.cpp", content);
+        output = converter.convert_to_string("a.cpp");
+    }
+    EXPECT(outputs[0] == outputs[1] && outputs[1] == outputs[2]);
+
+    auto verify = cache.find("    VERIFY(x);");
+    EXPECT(verify.entry && !verify.entry->depends_on_tokens && verify.entry->line);
+    if (verify.entry && verify.entry->line)
+        EXPECT(outputs[2].find(*verify.entry->line + "\n") != std::string::npos);
+    auto adopt = cache.find("    return adopt_ref(*new Node());");
+    EXPECT(adopt.entry && adopt.entry->depends_on_tokens && !adopt.entry->line);
+}
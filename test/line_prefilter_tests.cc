@@ -0,0 +1,148 @@
+#include <array>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "line_prefilter.h"
+#include "rule_set.h"
+#include "test.h"
+
+namespace {
+
+using Implementation = LinePrefilter::Implementation;
+
+constexpr std::array implementations { Implementation::Scalar, Implementation::Sse2, Implementation::Avx2 };
+
+// One flag per line, a line containing any of `keys` as two adjacent bytes.
+std::vector<uint8_t> reference_flags(std::string_view buffer, std::span<std::string_view const> keys)
+{
+    std::vector<uint8_t> flags;
+    for (size_t start = 0; start < buffer.size();) {
+        auto end = std::min(buffer.find('\n', start), buffer.size());
+        auto line = buffer.substr(start, end - start);
+        bool found = false;
+        for (auto key : keys)
+            found = found || line.find(key) != std::string_view::npos;
+        flags.push_back(found);
+        start = end + 1;
+    }
+    return flags;
+}
+
+// Checks every supported implementation against the reference.
+void expect_flags(LinePrefilter const& prefilter, std::string_view buffer, std::span<std::string_view const> keys)
+{
+    auto expected = reference_flags(buffer, keys);
+    for (auto implementation : implementations) {
+        if (!prefilter.supports(implementation))
+            continue;
+        std::vector<uint8_t> flags { 7, 7, 7 };
+        prefilter.flag_lines(buffer, flags, implementation);
+        if (flags != expected)
+            report_failure(__FILE__, __LINE__, fmt::format("implementation {} differs on \"{}\"", static_cast<int>(implementation), buffer));
+    }
+}
+
+constexpr std::array<std::string_view, 4> keys { "->", "::", "ab", "ba" };
+
+}
+
+TEST_CASE(line_prefilter_flags_lines_with_keys)
+{
+    LinePrefilter prefilter { keys };
+    std::vector<uint8_t> flags;
+    prefilter.flag_lines("x->y\nz\na:b\n::\n", flags);
+    EXPECT(flags == (std::vector<uint8_t> { 1, 0, 0, 1 }));
+    prefilter.flag_lines("no\nab", flags);
+    EXPECT(flags == (std::vector<uint8_t> { 0, 1 }));
+    prefilter.flag_lines("", flags);
+    EXPECT(flags.empty());
+}
+
+TEST_CASE(line_prefilter_rejects_keys_that_are_not_two_bytes)
+{
+    std::array<std::string_view, 2> bad_keys { "->", "abc" };
+    EXPECT_THROWS_WITH(LinePrefilter { bad_keys }, "'abc' is not two bytes long");
+}
+
+TEST_CASE(line_prefilter_implementations_agree_at_block_boundaries)
+{
+    LinePrefilter prefilter { keys };
+    // A key that starts on the last byte of a 16 or 32 byte block ends in the
+    // next one, the last key of the buffer is in the tail the vector loops leave.
+    for (size_t length : { 17, 31, 33, 48, 64, 65, 100 }) {
+        for (size_t offset : { 0, 14, 15, 16, 30, 31, 32, 33 }) {
+            if (offset + 2 > length)
+                continue;
+            std::string buffer(length, 'x');
+            buffer[offset] = '-';
+            buffer[offset + 1] = '>';
+            expect_flags(prefilter, buffer, keys);
+            buffer[length / 2] = '\n';
+            expect_flags(prefilter, buffer, keys);
+            buffer[length - 2] = ':';
+            buffer[length - 1] = ':';
+            expect_flags(prefilter, buffer, keys);
+            buffer[length - 1] = '\n';
+            expect_flags(prefilter, buffer, keys);
+        }
+    }
+}
+
+TEST_CASE(line_prefilter_implementations_agree_on_random_buffers)
+{
+    LinePrefilter prefilter { keys };
+    std::mt19937 random { 1234 };
+    constexpr std::string_view alphabet = "-> :abx\n\n";
+    std::uniform_int_distribution<size_t> pick { 0, alphabet.size() - 1 };
+    for (size_t length = 0; length < 200; ++length) {
+        for (int repeat = 0; repeat < 20; ++repeat) {
+            std::string buffer;
+            for (size_t i = 0; i < length; ++i)
+                buffer += alphabet[pick(random)];
+            expect_flags(prefilter, buffer, keys);
+        }
+    }
+}
+
+TEST_CASE(line_prefilter_implementations_agree_with_the_built_in_rules)
+{
+    auto const& prefilter = RuleSet::built_in().prefilter();
+    constexpr std::string_view source =
+        "#include <AK/Vector.h>\n"
+        "void f(Vector<int> const& values) { auto x = values.first(); }\n"
+        "int main() { return 0; }\n"
+        "StringBuilder builder; builder.append(\"text\"); auto s = builder.to_byte_string();\n"
+        "nothing here\n";
+    std::vector<uint8_t> expected;
+    prefilter.flag_lines(source, expected, Implementation::Scalar);
+    EXPECT_EQ(expected.size(), 5u);
+    for (auto implementation : implementations) {
+        if (!prefilter.supports(implementation))
+            continue;
+        for (size_t length = 0; length <= source.size(); ++length) {
+            std::vector<uint8_t> scalar;
+            std::vector<uint8_t> flags;
+            prefilter.flag_lines(source.substr(0, length), scalar, Implementation::Scalar);
+            prefilter.flag_lines(source.substr(0, length), flags, implementation);
+            if (flags != scalar)
+                report_failure(__FILE__, __LINE__, fmt::format("implementation {} differs at length {}", static_cast<int>(implementation), length));
+        }
+    }
+}
+
+TEST_CASE(line_prefilter_refuses_sse2_with_too_many_distinct_bytes)
+{
+    std::vector<std::string> storage;
+    for (char c = 'A'; c <= 'Z'; ++c)
+        storage.push_back({ c, '!' });
+    for (char c = 'a'; c <= 'z'; ++c)
+        storage.push_back({ c, '?' });
+    std::vector<std::string_view> many_keys(storage.begin(), storage.end());
+    LinePrefilter prefilter { many_keys };
+    EXPECT(prefilter.supports(Implementation::Scalar));
+    EXPECT(!prefilter.supports(Implementation::Sse2));
+    std::vector<uint8_t> flags;
+    EXPECT_THROWS_WITH(prefilter.flag_lines("x", flags, Implementation::Sse2), "not supported");
+    expect_flags(prefilter, "some text with Q! in it and a line\nwithout any key that is longer than 32 bytes\nz?", many_keys);
+}
@@ -0,0 +1,44 @@
+#include <string>
+#include <vector>
+#include "perfect_hash.h"
+#include "test.h"
+
+TEST_CASE(perfect_hash_finds_every_key_at_its_index)
+{
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 10000; ++i)
+        keys.push_back(fmt::format("key{}", i));
+    PerfectHash hash { keys };
+    EXPECT_EQ(hash.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        EXPECT_EQ(hash.find(keys[i]), std::optional<size_t> { i });
+}
+
+TEST_CASE(perfect_hash_misses_keys_it_was_not_built_from)
+{
+    PerfectHash hash { { "Vector", "Span", "Optional", "String" } };
+    EXPECT_EQ(hash.find("Vector"), std::optional<size_t> { 0 });
+    EXPECT_EQ(hash.find("String"), std::optional<size_t> { 3 });
+    for (auto key : { "", "vector", "Vecto", "Vectorr", "HashMap", "String " })
+        EXPECT(!hash.find(key));
+    for (size_t i = 0; i < 1000; ++i)
+        EXPECT(!hash.find(fmt::format("miss{}", i)));
+}
+
+TEST_CASE(perfect_hash_with_one_or_no_keys)
+{
+    PerfectHash empty;
+    EXPECT_EQ(empty.size(), 0u);
+    EXPECT(!empty.find("x"));
+    EXPECT(!empty.find(""));
+
+    PerfectHash one { { "x" } };
+    EXPECT_EQ(one.find("x"), std::optional<size_t> { 0 });
+    EXPECT(!one.find("y"));
+}
+
+TEST_CASE(perfect_hash_rejects_empty_and_duplicate_keys)
+{
+    EXPECT_THROWS_WITH(PerfectHash({ "a", "" }), "empty perfect hash key");
+    EXPECT_THROWS_WITH(PerfectHash({ "a", "b", "a" }), "'a' is given twice");
+}
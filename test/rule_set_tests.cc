@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include "rule_set.h"
+#include "test.h"
+
+namespace {
+
+std::vector<std::pair<size_t, std::string>> literals_in(RuleSet const& rules, std::string_view line)
+{
+    std::vector<std::pair<size_t, std::string>> matches;
+    rules.for_each_literal(line, [&](size_t position, RuleSet::LiteralRule const& rule) {
+        matches.emplace_back(position, rule.replacement);
+    });
+    return matches;
+}
+
+}
+
+TEST_CASE(rule_set_adds_rules_from_a_rule_file)
+{
+    RuleSet rules;
+    rules.add_rules(
+        "# A comment, then an empty line\n"
+        "\n"
+        "identifier Bitmap Image <image.h>\n"
+        "identifier MyVector my::vector \"my/vector.h\" # trailing comment\n"
+        "literal ab X\n"
+        "literal abc Y\n"
+        "literal a\\sb Z\n"
+        "include <LibCore/ \"core/ snake h\n"
+        "drop-include <LibGfx/\n"
+        "debug MY_DEBUG\n"
+        "debug *_TRACE\n",
+        "test.rules");
+
+    auto const* rule = rules.find_identifier("MyVector");
+    EXPECT(rule != nullptr);
+    if (rule) {
+        EXPECT_EQ(rule->replacement, "my::vector");
+        EXPECT_EQ(rule->header, "\"my/vector.h\"");
+    }
+    EXPECT(rules.find_identifier("Bitmap") && rules.find_identifier("Bitmap")->header == "<image.h>");
+    EXPECT(!rules.find_identifier("MyVecto"));
+    EXPECT(rules.find_identifier("Vector") != nullptr);
+    EXPECT(rules.find_identifier("MY_DEBUG")->is_debug_constant);
+    EXPECT(rules.is_debug_constant("HTTP_TRACE"));
+    EXPECT(!rules.is_debug_constant("_TRACE"));
+
+    // The longest literal at a position wins, matches don't overlap.
+    auto matches = literals_in(rules, "abc ab a b abab");
+    EXPECT(matches == (std::vector<std::pair<size_t, std::string>> { { 0, "Y" }, { 4, "X" }, { 7, "Z" }, { 11, "X" }, { 13, "X" } }));
+
+    auto const& includes = rules.include_rules();
+    auto core = std::ranges::find(includes, std::string { "<LibCore/" }, &RuleSet::IncludeRule::from);
+    EXPECT(core != includes.end());
+    if (core != includes.end()) {
+        EXPECT_EQ(core->to, "\"core/");
+        EXPECT(core->casing == RuleSet::IncludeCasing::Snake);
+        EXPECT_EQ(core->suffix, "h");
+    }
+    auto gfx = std::ranges::find(includes, std::string { "<LibGfx/" }, &RuleSet::IncludeRule::from);
+    EXPECT(gfx != includes.end() && gfx->to.empty());
+}
+
+TEST_CASE(rule_set_reports_malformed_rules_with_their_line)
+{
+    auto expect_error = [](std::string_view text, std::string_view message) {
+        RuleSet rules;
+        EXPECT_THROWS_WITH(rules.add_rules(text, "bad.rules"), message);
+    };
+    expect_error("frobnicate a b", "bad.rules:1: unknown rule kind 'frobnicate'");
+    expect_error("# comment\nidentifier OnlyOne", "bad.rules:2: identifier rules take 2 to 3 arguments");
+    expect_error("identifier a b <c> d", "identifier rules take 2 to 3 arguments");
+    expect_error("identifier 9lives x", "'9lives' is not an identifier of two or more characters");
+    expect_error("identifier x y", "'x' is not an identifier of two or more characters");
+    expect_error("identifier Foo Bar baz.h", "'baz.h' is not a header like <name> or \"name\"");
+    expect_error("literal a b", "literals need two or more characters");
+    expect_error("include LibCore/ <core/", "'LibCore/' does not start an include argument");
+    expect_error("include <LibCore/ core/", "'core/' does not start an include argument");
+    expect_error("include <A/ <a/ camel", "unknown casing 'camel', expected keep, lower or snake");
+    expect_error("drop-include <A/ <B/", "drop-include rules take 1 to 1 arguments");
+    expect_error("debug *", "'*' is neither an identifier nor *<suffix>");
+    expect_error("debug 1_DEBUG", "'1_DEBUG' is neither an identifier nor *<suffix>");
+    expect_error("literal a\\q b", "unknown escape \\q");
+    expect_error("literal ab b\\", "\\ at the end of the line");
+}
+
+TEST_CASE(rule_set_rejects_a_second_rule_for_a_name)
+{
+    auto expect_error = [](std::string_view text, std::string_view message) {
+        RuleSet rules;
+        EXPECT_THROWS_WITH(rules.add_rules(text, "dup.rules"), message);
+    };
+    expect_error("identifier Vector my::vector", "dup.rules:1: 'Vector' already has a rule");
+    expect_error("identifier Foo a\nidentifier Foo b", "dup.rules:2: 'Foo' already has a rule");
+    expect_error("debug FOO_DEBUG\nidentifier FOO_DEBUG x", "dup.rules:2: 'FOO_DEBUG' already has a rule");
+    expect_error("include <A/ <a/\ndrop-include <A/", "dup.rules:2: '<A/' already has a rule");
+}
+
+TEST_CASE(rule_set_prefilter_flags_lines_of_added_rules)
+{
+    RuleSet rules;
+    std::vector<uint8_t> flags;
+    rules.prefilter().flag_lines("zq\n", flags);
+    EXPECT(flags == (std::vector<uint8_t> { 0 }));
+    rules.add_rules("literal zq x", "test.rules");
+    rules.prefilter().flag_lines("zq\n", flags);
+    EXPECT(flags == (std::vector<uint8_t> { 1 }));
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include "lexer.h"
+#include "symbol_database.h"
+#include "test.h"
+
+namespace {
+
+constexpr std::string_view source = R"~(
+namespace Web {
+class Node {
+public:
+    Node* parent() const;
+    Vector<NonnullRefPtr<Node>> const& children() const { return m_children; }
+
+private:
+    Vector<NonnullRefPtr<Node>> m_children;
+    String m_name;
+};
+
+class Element final : public Node {
+    StringBuilder m_builder;
+    int width() const;
+};
+}
+)~";
+
+// A file in the temporary directory that is removed with the object.
+class TemporaryFile {
+public:
+    explicit TemporaryFile(std::string_view name)
+        : m_path(std::filesystem::temp_directory_path() / fmt::format("ak-to-std-tests-{}-{}", getpid(), name))
+    {
+    }
+    ~TemporaryFile()
+    {
+        std::error_code error;
+        std::filesystem::remove(m_path, error);
+    }
+
+    std::string path() const { return m_path.string(); }
+
+    std::string read() const
+    {
+        std::ifstream file { m_path, std::ios::binary };
+        return { std::istreambuf_iterator<char> { file }, {} };
+    }
+    void write(std::string_view content) const
+    {
+        std::ofstream file { m_path, std::ios::binary | std::ios::trunc };
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+
+private:
+    std::filesystem::path m_path;
+};
+
+void write_database(TemporaryFile const& file)
+{
+    SymbolDatabase::Builder builder;
+    builder.add_source("Node.h", source);
+    EXPECT_EQ(builder.class_count(), 2u);
+    builder.write(file.path());
+}
+
+// Offsets of header fields after the 8 byte magic, see SymbolDatabase::Header.
+// The 36 byte header is followed by the 28 byte member entries and then the
+// member slots.
+enum HeaderField : size_t {
+    Version = 8,
+    MemberCount = 12,
+    MemberSlotCount = 16,
+};
+constexpr size_t header_size = 36;
+constexpr size_t member_entry_size = 28;
+
+uint32_t read_u32(std::string const& data, size_t offset)
+{
+    uint32_t value;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+void write_u32(std::string& data, size_t offset, uint32_t value)
+{
+    memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+size_t member_slots_offset(std::string const& data)
+{
+    return header_size + read_u32(data, MemberCount) * member_entry_size;
+}
+
+}
+
+TEST_CASE(symbol_database_round_trip)
+{
+    TemporaryFile file { "round-trip.symdb" };
+    write_database(file);
+    auto database = SymbolDatabase::open(file.path());
+
+    auto children = database.find_member("Node", "m_children");
+    EXPECT(children.has_value());
+    if (children) {
+        EXPECT_EQ(children->type, "Vector<NonnullRefPtr<Node>>");
+        EXPECT(children->kind == SymbolDatabase::MemberKind::Field);
+    }
+    auto parent = database.find_member("Node", "parent");
+    EXPECT(parent && parent->type == "Node*" && parent->kind == SymbolDatabase::MemberKind::Method);
+    auto builder = database.find_member("Element", "m_builder");
+    EXPECT(builder && builder->type == "StringBuilder");
+
+    // Members of a base class are found through the derived one.
+    auto name = database.find_member("Element", "m_name");
+    EXPECT(name && name->type == "String");
+
+    EXPECT(!database.find_member("Node", "m_builder"));
+    EXPECT(!database.find_member("Node", "m_nam"));
+    EXPECT(!database.find_member("Document", "m_name"));
+    EXPECT(!database.find_member("", ""));
+}
+
+TEST_CASE(symbol_database_keeps_nothing_of_rejected_files)
+{
+    SymbolDatabase::Builder builder;
+    builder.add_source("Node.h", source);
+    EXPECT_THROWS_WITH(builder.add_source("Broken.h", "class Broken {\n    int m_x;\n"), "Broken.h: unbalanced braces");
+    EXPECT_THROWS_WITH(builder.add_source("Node2.h", "class Node {\n    int m_extra;\n    void f() {\n};\n"), "unbalanced braces");
+    EXPECT_EQ(builder.class_count(), 2u);
+    EXPECT_EQ(builder.member_count(), 6u);
+
+    // A class defined again keeps its first declarations and gains the new ones.
+    builder.add_source("Node3.h", "class Node : public Base {\n    int m_name;\n    int m_extra;\n};\n");
+    EXPECT_EQ(builder.class_count(), 2u);
+    EXPECT_EQ(builder.member_count(), 7u);
+
+    TemporaryFile file { "rejected.symdb" };
+    builder.write(file.path());
+    auto database = SymbolDatabase::open(file.path());
+    auto name = database.find_member("Node", "m_name");
+    EXPECT(name && name->type == "String");
+    auto extra = database.find_member("Element", "m_extra");
+    EXPECT(extra && extra->type == "int");
+    EXPECT(!database.find_member("Broken", "m_x"));
+}
+
+TEST_CASE(symbol_database_rejects_files_that_are_not_databases)
+{
+    TemporaryFile file { "corrupt.symdb" };
+    write_database(file);
+    auto const good = file.read();
+
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path() + ".missing"), "unable to open");
+
+    file.write("");
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path()), "is not a symbol database");
+
+    auto bad_magic = good;
+    bad_magic[0] = 'X';
+    file.write(bad_magic);
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path()), "is not a symbol database of version 1");
+
+    auto bad_version = good;
+    write_u32(bad_version, Version, 2);
+    file.write(bad_version);
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path()), "is not a symbol database of version 1");
+
+    file.write(std::string_view { good }.substr(0, good.size() - 1));
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path()), "is truncated or corrupt");
+
+    file.write(good + '\0');
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path()), "is truncated or corrupt");
+
+    // Three slots instead of four, with the size adjusted to match.
+    auto odd_slots = good;
+    auto slot_count = read_u32(good, MemberSlotCount);
+    auto slots_offset = member_slots_offset(good);
+    write_u32(odd_slots, MemberSlotCount, slot_count - 1);
+    odd_slots.erase(slots_offset, sizeof(uint32_t));
+    file.write(odd_slots);
+    EXPECT_THROWS_WITH(SymbolDatabase::open(file.path()), "is truncated or corrupt");
+
+    file.write(good);
+    EXPECT(SymbolDatabase::open(file.path()).find_member("Node", "m_name").has_value());
+}
+
+TEST_CASE(symbol_database_survives_corrupt_slots)
+{
+    TemporaryFile file { "slots.symdb" };
+    write_database(file);
+    auto data = file.read();
+    auto slot_count = read_u32(data, MemberSlotCount);
+    auto slots_offset = member_slots_offset(data);
+
+    // No empty slot: a miss has to stop after probing every slot.
+    for (uint32_t i = 0; i < slot_count; ++i)
+        write_u32(data, slots_offset + i * 4, 1);
+    file.write(data);
+    auto full = SymbolDatabase::open(file.path());
+    EXPECT(!full.find_member("Node", "no_such_member"));
+
+    // Indices past the member table.
+    for (uint32_t i = 0; i < slot_count; ++i)
+        write_u32(data, slots_offset + i * 4, 0xffffffff - i);
+    file.write(data);
+    auto out_of_range = SymbolDatabase::open(file.path());
+    EXPECT(!out_of_range.find_member("Node", "m_children"));
+}
+
+TEST_CASE(symbol_database_finds_the_enclosing_class)
+{
+    PackedTokens tokens;
+    std::vector<std::string_view> lines;
+    for (size_t start = 0; start < source.size();) {
+        auto end = std::min(source.find('\n', start), source.size());
+        lines.push_back(source.substr(start, end - start));
+        start = end + 1;
+    }
+    LexState state = LexState::Code;
+    for (size_t i = 0; i < lines.size(); ++i)
+        lex_line(lines[i], static_cast<uint32_t>(i), state, tokens);
+    auto text = [&](size_t index) {
+        auto const& token = tokens[index];
+        return lines[token.start_line].substr(token.start_column, token.end_column + 1 - token.start_column);
+    };
+    auto index_of = [&](std::string_view token_text) {
+        size_t index = 0;
+        while (index < tokens.size() && text(index) != token_text)
+            ++index;
+        return index;
+    };
+
+    auto scopes = class_scopes(tokens, text);
+    EXPECT_EQ(scopes.size(), 2u);
+    EXPECT_EQ(enclosing_class(scopes, index_of("m_children")), std::optional<std::string_view> { "Node" });
+    EXPECT_EQ(enclosing_class(scopes, index_of("m_builder")), std::optional<std::string_view> { "Element" });
+    EXPECT(!enclosing_class(scopes, index_of("namespace")));
+}
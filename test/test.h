@@ -0,0 +1,54 @@
+#pragma once
+#include <fmt/format.h>
+#include <exception>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// A minimal harness for the unit tests: TEST_CASE() registers a function that
+// test_main.cc runs, the EXPECT macros report a failure and let the test go on.
+
+struct TestCase {
+    std::string_view name;
+    std::function<void()> function;
+};
+
+std::vector<TestCase>& test_cases();
+void report_failure(char const* file, int line, std::string_view message);
+
+struct TestRegistration {
+    TestRegistration(std::string_view name, std::function<void()> function)
+    {
+        test_cases().push_back({ name, std::move(function) });
+    }
+};
+
+#define TEST_CASE(name)                                                         \
+    static void test_##name();                                                  \
+    static TestRegistration const test_registration_##name(#name, test_##name); \
+    static void test_##name()
+
+#define EXPECT(condition)                                                 \
+    do {                                                                  \
+        if (!(condition))                                                 \
+            report_failure(__FILE__, __LINE__, "EXPECT(" #condition ")"); \
+    } while (false)
+
+#define EXPECT_EQ(a, b)                                                      \
+    do {                                                                     \
+        if (!((a) == (b)))                                                   \
+            report_failure(__FILE__, __LINE__, "EXPECT_EQ(" #a ", " #b ")"); \
+    } while (false)
+
+// Expects `expression` to throw an exception whose what() contains `substring`.
+#define EXPECT_THROWS_WITH(expression, substring)                                                    \
+    do {                                                                                             \
+        try {                                                                                        \
+            (void)(expression);                                                                      \
+            report_failure(__FILE__, __LINE__, "EXPECT_THROWS_WITH(" #expression "): no exception"); \
+        } catch (std::exception const& exception) {                                                  \
+            if (std::string_view(exception.what()).find(substring) == std::string_view::npos)        \
+                report_failure(__FILE__, __LINE__,                                                   \
+                    fmt::format("EXPECT_THROWS_WITH({}): \"{}\"", #expression, exception.what())); \
+        }                                                                                            \
+    } while (false)
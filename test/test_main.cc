@@ -0,0 +1,40 @@
+#include <fmt/core.h>
+#include <exception>
+#include "test.h"
+
+namespace {
+
+size_t failures_in_current_test = 0;
+
+}
+
+std::vector<TestCase>& test_cases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void report_failure(char const* file, int line, std::string_view message)
+{
+    fmt::print(stderr, "{}:{}: {}\n", file, line, message);
+    ++failures_in_current_test;
+}
+
+int main()
+{
+    size_t failed_tests = 0;
+    for (auto const& test_case : test_cases()) {
+        failures_in_current_test = 0;
+        try {
+            test_case.function();
+        } catch (std::exception const& exception) {
+            fmt::print(stderr, "{}: uncaught exception: {}\n", test_case.name, exception.what());
+            ++failures_in_current_test;
+        }
+        fmt::print("{} {}\n", failures_in_current_test == 0 ? "PASS" : "FAIL", test_case.name);
+        if (failures_in_current_test > 0)
+            ++failed_tests;
+    }
+    fmt::print("{} of {} tests failed\n", failed_tests, test_cases().size());
+    return failed_tests == 0 ? 0 : 1;
+}